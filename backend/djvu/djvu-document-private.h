@@ -41,6 +41,27 @@ struct _DjvuDocument {
 	ddjvu_fileinfo_t *fileinfo_pages;
 	gint		  n_pages;
 	GHashTable	 *file_ids;
+
+	/* Decoded pages, most recently used first */
+	GHashTable	 *d_pages;
+	GQueue		  d_pages_lru;
+
+	/* Page texts, most recently used first */
+	GHashTable	 *text_pages;
+	GQueue		  text_pages_lru;
+	guint		  text_pages_hits;
+	guint		  text_pages_misses;
+
+	/* Pages of indirect documents whose size is still a guess, and
+	 * the real sizes found while handling pageinfo messages, waiting
+	 * to be reported from the main loop. Protected by sizes_lock */
+	GMutex		  sizes_lock;
+	gboolean	 *provisional_sizes;
+	gint		  n_provisional_sizes;
+	gdouble		  provisional_width;
+	gdouble		  provisional_height;
+	GArray		 *refined_sizes;
+	guint		  refine_sizes_id;
 };
 
 int  djvu_document_get_n_pages (EvDocument   *document);
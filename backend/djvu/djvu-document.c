@@ -67,6 +67,36 @@ EV_BACKEND_REGISTER_WITH_CODE (DjvuDocument, djvu_document,
 
 #define EV_DJVU_ERROR ev_djvu_error_quark ()
 
+/* Number of decoded pages kept, and of pages after the rendered one
+ * decoded ahead. Decoded scanned pages can take a few MB each. */
+#define DJVU_PAGE_CACHE_SIZE 6
+#define DJVU_PAGE_LOOKAHEAD  2
+
+typedef struct {
+	gint          index;
+	ddjvu_page_t *d_page;
+	GList        *link;
+} DjvuPageCacheEntry;
+
+/* Number of page texts kept. Searching a document walks all its pages,
+ * so this only helps with selections and searches around the current
+ * page, but parsing and indexing a page text is slow. */
+#define DJVU_TEXT_CACHE_SIZE 16
+
+typedef struct {
+	gint          index;
+	miniexp_t     page_text;
+	/* Indexed for case insensitive and case sensitive searches */
+	DjvuTextPage *text_pages[2];
+	GList        *link;
+} DjvuTextCacheEntry;
+
+typedef struct {
+	gint    index;
+	gdouble width;
+	gdouble height;
+} DjvuPageSize;
+
 static GQuark
 ev_djvu_error_quark (void)
 {
@@ -77,8 +107,11 @@ ev_djvu_error_quark (void)
 	return q;
 }
 
+static void     djvu_document_refine_page_sizes (DjvuDocument *djvu_document);
+static gboolean djvu_document_report_page_sizes (DjvuDocument *djvu_document);
+
 static void
-handle_message (const ddjvu_message_t *msg, GError **error)
+handle_message (DjvuDocument *djvu_document, const ddjvu_message_t *msg, GError **error)
 {
 	switch (msg->m_any.tag) {
 	        case DDJVU_ERROR: {
@@ -103,6 +136,11 @@ handle_message (const ddjvu_message_t *msg, GError **error)
 			return;
 			}						     
 			break;
+	        case DDJVU_PAGEINFO:
+			g_mutex_lock (&djvu_document->sizes_lock);
+			djvu_document_refine_page_sizes (djvu_document);
+			g_mutex_unlock (&djvu_document->sizes_lock);
+			break;
 	        default:
 			break;
 	}
@@ -121,11 +159,21 @@ djvu_handle_events (DjvuDocument *djvu_document, int wait, GError **error)
 		ddjvu_message_wait (ctx);
 
 	while ((msg = ddjvu_message_peek (ctx))) {
-		handle_message (msg, error);
+		handle_message (djvu_document, msg, error);
 		ddjvu_message_pop (ctx);
 		if (error && *error)
-			return;
+			break;
 	}
+
+	g_mutex_lock (&djvu_document->sizes_lock);
+	if (djvu_document->refined_sizes->len > 0 && !djvu_document->refine_sizes_id) {
+		djvu_document->refine_sizes_id =
+			g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+					 (GSourceFunc)djvu_document_report_page_sizes,
+					 g_object_ref (djvu_document),
+					 (GDestroyNotify)g_object_unref);
+	}
+	g_mutex_unlock (&djvu_document->sizes_lock);
 }
 
 static void
@@ -136,7 +184,7 @@ djvu_wait_for_message (DjvuDocument *djvu_document, ddjvu_message_tag_t message,
 
 	ddjvu_message_wait (ctx);
 	while ((msg = ddjvu_message_peek (ctx)) && (msg->m_any.tag != message)) {
-		handle_message (msg, error);
+		handle_message (djvu_document, msg, error);
 		ddjvu_message_pop (ctx);
 		if (error && *error)
 			return;
@@ -145,6 +193,257 @@ djvu_wait_for_message (DjvuDocument *djvu_document, ddjvu_message_tag_t message,
 		ddjvu_message_pop (ctx);
 }
 
+static void
+djvu_page_cache_entry_free (DjvuPageCacheEntry *entry)
+{
+	ddjvu_page_release (entry->d_page);
+	g_slice_free (DjvuPageCacheEntry, entry);
+}
+
+static void
+djvu_document_clear_pages (DjvuDocument *djvu_document)
+{
+	g_queue_clear (&djvu_document->d_pages_lru);
+	g_hash_table_remove_all (djvu_document->d_pages);
+}
+
+/* Returns the decoder of page @index, creating it if needed. Creating a
+ * ddjvu_page_t starts decoding it in the ddjvulibre decoder threads, the
+ * page is ready once ddjvu_page_decoding_done() returns TRUE. */
+static ddjvu_page_t *
+djvu_document_get_d_page (DjvuDocument *djvu_document,
+			  gint          index)
+{
+	DjvuPageCacheEntry *entry;
+
+	entry = g_hash_table_lookup (djvu_document->d_pages, GINT_TO_POINTER (index));
+	if (entry) {
+		g_queue_unlink (&djvu_document->d_pages_lru, entry->link);
+		g_queue_push_head_link (&djvu_document->d_pages_lru, entry->link);
+
+		return entry->d_page;
+	}
+
+	entry = g_slice_new (DjvuPageCacheEntry);
+	entry->index = index;
+	entry->d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, index);
+	if (!entry->d_page) {
+		g_slice_free (DjvuPageCacheEntry, entry);
+		return NULL;
+	}
+
+	g_queue_push_head (&djvu_document->d_pages_lru, entry);
+	entry->link = djvu_document->d_pages_lru.head;
+	g_hash_table_insert (djvu_document->d_pages, GINT_TO_POINTER (index), entry);
+
+	while (djvu_document->d_pages_lru.length > DJVU_PAGE_CACHE_SIZE) {
+		DjvuPageCacheEntry *last;
+
+		last = (DjvuPageCacheEntry *)g_queue_pop_tail (&djvu_document->d_pages_lru);
+		g_hash_table_remove (djvu_document->d_pages, GINT_TO_POINTER (last->index));
+	}
+
+	return entry->d_page;
+}
+
+/* Returns the decoded page @index, after queueing the decoding of the
+ * following pages so that they are ready when the user turns the page */
+static ddjvu_page_t *
+djvu_document_decode_page (DjvuDocument *djvu_document,
+			   gint          index)
+{
+	ddjvu_page_t *d_page;
+	gint          i;
+
+	for (i = MIN (index + DJVU_PAGE_LOOKAHEAD, djvu_document->n_pages - 1); i > index; i--)
+		djvu_document_get_d_page (djvu_document, i);
+
+	/* Requested last, so that it's the most recently used page */
+	d_page = djvu_document_get_d_page (djvu_document, index);
+	if (!d_page)
+		return NULL;
+
+	while (!ddjvu_page_decoding_done (d_page))
+		djvu_handle_events (djvu_document, TRUE, NULL);
+
+	return d_page;
+}
+
+static void
+djvu_text_cache_entry_free (DjvuTextCacheEntry *entry,
+			    DjvuDocument       *djvu_document)
+{
+	if (entry->text_pages[0])
+		djvu_text_page_free (entry->text_pages[0]);
+	if (entry->text_pages[1])
+		djvu_text_page_free (entry->text_pages[1]);
+	if (entry->page_text != miniexp_nil)
+		ddjvu_miniexp_release (djvu_document->d_document, entry->page_text);
+	g_slice_free (DjvuTextCacheEntry, entry);
+}
+
+static void
+djvu_document_clear_text_pages (DjvuDocument *djvu_document)
+{
+	DjvuTextCacheEntry *entry;
+
+	while ((entry = g_queue_pop_head (&djvu_document->text_pages_lru)))
+		djvu_text_cache_entry_free (entry, djvu_document);
+	g_hash_table_remove_all (djvu_document->text_pages);
+}
+
+static DjvuTextCacheEntry *
+djvu_document_get_text_cache_entry (DjvuDocument *djvu_document,
+				    gint          index)
+{
+	DjvuTextCacheEntry *entry;
+	miniexp_t           page_text;
+
+	entry = g_hash_table_lookup (djvu_document->text_pages, GINT_TO_POINTER (index));
+	if (entry) {
+		djvu_document->text_pages_hits++;
+		g_queue_unlink (&djvu_document->text_pages_lru, entry->link);
+		g_queue_push_head_link (&djvu_document->text_pages_lru, entry->link);
+
+		return entry;
+	}
+
+	djvu_document->text_pages_misses++;
+
+	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
+							 index, "char")) == miniexp_dummy)
+		djvu_handle_events (djvu_document, TRUE, NULL);
+
+	entry = g_slice_new0 (DjvuTextCacheEntry);
+	entry->index = index;
+	entry->page_text = page_text;
+
+	g_queue_push_head (&djvu_document->text_pages_lru, entry);
+	entry->link = djvu_document->text_pages_lru.head;
+	g_hash_table_insert (djvu_document->text_pages, GINT_TO_POINTER (index), entry);
+
+	while (djvu_document->text_pages_lru.length > DJVU_TEXT_CACHE_SIZE) {
+		DjvuTextCacheEntry *last;
+
+		last = (DjvuTextCacheEntry *)g_queue_pop_tail (&djvu_document->text_pages_lru);
+		g_hash_table_remove (djvu_document->text_pages, GINT_TO_POINTER (last->index));
+		djvu_text_cache_entry_free (last, djvu_document);
+	}
+
+	return entry;
+}
+
+/* Returns the text of page @index, owned by the document, or miniexp_nil
+ * if the page has no text */
+static miniexp_t
+djvu_document_get_page_text (DjvuDocument *djvu_document,
+			     gint          index)
+{
+	return djvu_document_get_text_cache_entry (djvu_document, index)->page_text;
+}
+
+/* Returns the text page of page @index indexed for searching, owned by
+ * the document, or %NULL if the page has no text */
+static DjvuTextPage *
+djvu_document_get_text_page (DjvuDocument *djvu_document,
+			     gint          index,
+			     gboolean      case_sensitive)
+{
+	DjvuTextCacheEntry *entry;
+	DjvuTextPage       *tpage;
+
+	entry = djvu_document_get_text_cache_entry (djvu_document, index);
+	if (entry->page_text == miniexp_nil)
+		return NULL;
+
+	tpage = entry->text_pages[case_sensitive ? 1 : 0];
+	if (!tpage) {
+		tpage = djvu_text_page_new (entry->page_text);
+		djvu_text_page_index_text (tpage, case_sensitive);
+		entry->text_pages[case_sensitive ? 1 : 0] = tpage;
+	}
+
+	return tpage;
+}
+
+static void
+djvu_document_clear_provisional_sizes (DjvuDocument *djvu_document)
+{
+	g_mutex_lock (&djvu_document->sizes_lock);
+	g_free (djvu_document->provisional_sizes);
+	djvu_document->provisional_sizes = NULL;
+	djvu_document->n_provisional_sizes = 0;
+	g_array_set_size (djvu_document->refined_sizes, 0);
+	g_mutex_unlock (&djvu_document->sizes_lock);
+}
+
+static gboolean
+djvu_document_report_page_sizes (DjvuDocument *djvu_document)
+{
+	GArray *sizes;
+	guint   i;
+
+	g_mutex_lock (&djvu_document->sizes_lock);
+	sizes = djvu_document->refined_sizes;
+	djvu_document->refined_sizes = g_array_new (FALSE, FALSE, sizeof (DjvuPageSize));
+	djvu_document->refine_sizes_id = 0;
+	g_mutex_unlock (&djvu_document->sizes_lock);
+
+	for (i = 0; i < sizes->len; i++) {
+		DjvuPageSize *size = &g_array_index (sizes, DjvuPageSize, i);
+
+		if (!ev_document_set_page_size (EV_DOCUMENT (djvu_document),
+						size->index, size->width, size->height))
+			break;
+	}
+
+	/* Still loading, the sizes are reported the next time messages
+	 * are handled */
+	if (i < sizes->len) {
+		g_mutex_lock (&djvu_document->sizes_lock);
+		g_array_append_vals (djvu_document->refined_sizes,
+				     &g_array_index (sizes, DjvuPageSize, i),
+				     sizes->len - i);
+		g_mutex_unlock (&djvu_document->sizes_lock);
+	}
+	g_array_free (sizes, TRUE);
+
+	return FALSE;
+}
+
+/* Called for every pageinfo message, from whichever thread handles the
+ * ddjvulibre messages, with sizes_lock held. The real sizes of the
+ * provisional pages whose file has been parsed are reported from the
+ * main loop, where ev_document_set_page_size() must be called. */
+static void
+djvu_document_refine_page_sizes (DjvuDocument *djvu_document)
+{
+	gint i;
+
+	for (i = 0; i < djvu_document->n_pages && djvu_document->n_provisional_sizes > 0; i++) {
+		ddjvu_pageinfo_t info;
+		ddjvu_status_t   r;
+		DjvuPageSize     size;
+
+		if (!djvu_document->provisional_sizes[i])
+			continue;
+
+		r = ddjvu_document_get_pageinfo (djvu_document->d_document, i, &info);
+		if (r < DDJVU_JOB_OK)
+			continue;
+
+		djvu_document->provisional_sizes[i] = FALSE;
+		djvu_document->n_provisional_sizes--;
+		if (r != DDJVU_JOB_OK)
+			continue;
+
+		size.index = i;
+		size.width = info.width * 72.0 / info.dpi;
+		size.height = info.height * 72.0 / info.dpi;
+		g_array_append_val (djvu_document->refined_sizes, size);
+	}
+}
+
 static gboolean
 djvu_document_load (EvDocument  *document,
 		    const char  *uri,
@@ -176,6 +475,9 @@ djvu_document_load (EvDocument  *document,
 		return FALSE;
 	}
 
+	djvu_document_clear_pages (djvu_document);
+	djvu_document_clear_text_pages (djvu_document);
+	djvu_document_clear_provisional_sizes (djvu_document);
 	if (djvu_document->d_document)
 	    ddjvu_document_release (djvu_document->d_document);
 
@@ -220,8 +522,14 @@ djvu_document_load (EvDocument  *document,
 		djvu_document->fileinfo_pages = g_new0 (ddjvu_fileinfo_t, djvu_document->n_pages);
 		djvu_document->file_ids = g_hash_table_new (g_str_hash, g_str_equal);
 	}
-	if (ddjvu_document_get_type (djvu_document->d_document) == DDJVU_DOCTYPE_INDIRECT)
+	if (ddjvu_document_get_type (djvu_document->d_document) == DDJVU_DOCTYPE_INDIRECT) {
 		check_for_missing_files = TRUE;
+		if (djvu_document->n_pages > 0) {
+			g_mutex_lock (&djvu_document->sizes_lock);
+			djvu_document->provisional_sizes = g_new0 (gboolean, djvu_document->n_pages);
+			g_mutex_unlock (&djvu_document->sizes_lock);
+		}
+	}
 
 	base = g_path_get_dirname (filename);
 
@@ -319,17 +627,55 @@ djvu_document_get_page_size (EvDocument   *document,
 			     double       *width,
 			     double       *height)
 {
-	DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
+	DjvuDocument    *djvu_document = DJVU_DOCUMENT (document);
+	ddjvu_pageinfo_t info;
+	gdouble          page_width, page_height;
 
 	g_return_if_fail (djvu_document->d_document);
 
+	/* The size of a page of an indirect document is only known once its
+	 * file has been parsed. Instead of parsing all the files on load,
+	 * guess that pages not parsed yet have the size of the previous
+	 * known page, and refine them as their pageinfo messages arrive. */
+	g_mutex_lock (&djvu_document->sizes_lock);
+	if (djvu_document->provisional_sizes && page->index > 0 &&
+	    ddjvu_document_get_pageinfo (djvu_document->d_document,
+					 page->index, &info) < DDJVU_JOB_OK) {
+		if (!djvu_document->provisional_sizes[page->index]) {
+			djvu_document->provisional_sizes[page->index] = TRUE;
+			djvu_document->n_provisional_sizes++;
+		}
+
+		if (width)
+			*width = djvu_document->provisional_width;
+		if (height)
+			*height = djvu_document->provisional_height;
+		g_mutex_unlock (&djvu_document->sizes_lock);
+
+		return;
+	}
+	g_mutex_unlock (&djvu_document->sizes_lock);
+
 	document_get_page_size (djvu_document, page->index,
-				width, height, NULL);
+				&page_width, &page_height, NULL);
+	g_mutex_lock (&djvu_document->sizes_lock);
+	djvu_document->provisional_width = page_width;
+	djvu_document->provisional_height = page_height;
+	g_mutex_unlock (&djvu_document->sizes_lock);
+
+	if (width)
+		*width = page_width;
+	if (height)
+		*height = page_height;
 }
 
+/* Renders @region of the page rendered with @rc, or the whole page if
+ * @region is %NULL. ddjvulibre only decodes the part of the page that
+ * intersects the render rectangle. */
 static cairo_surface_t *
-djvu_document_render (EvDocument      *document, 
-		      EvRenderContext *rc)
+djvu_document_render_internal (EvDocument            *document,
+			       EvRenderContext       *rc,
+			       cairo_rectangle_int_t *region)
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
 	cairo_surface_t *surface;
@@ -343,10 +689,9 @@ djvu_document_render (EvDocument      *document,
 	double page_width, page_height;
 	gint transformed_width, transformed_height;
 
-	d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, rc->page->index);
-	
-	while (!ddjvu_page_decoding_done (d_page))
-		djvu_handle_events(djvu_document, TRUE, NULL);
+	d_page = djvu_document_decode_page (djvu_document, rc->page->index);
+	if (!d_page)
+		return NULL;
 
 	document_get_page_size (djvu_document, rc->page->index, &page_width, &page_height, NULL);
 	rotation = ddjvu_page_get_initial_rotation (d_page);
@@ -372,17 +717,28 @@ djvu_document_render (EvDocument      *document,
 	}
 	rotation = rotation % 4;
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
-					      transformed_width, transformed_height);
-
-	rowstride = cairo_image_surface_get_stride (surface);
-	pixels = (gchar *)cairo_image_surface_get_data (surface);
-
 	prect.x = 0;
 	prect.y = 0;
 	prect.w = transformed_width;
 	prect.h = transformed_height;
-	rrect = prect;
+
+	/* ddjvulibre counts y from the bottom of the page rectangle
+	 * unless the y direction of the format is set, the region is
+	 * counted from the top */
+	if (region) {
+		rrect.x = region->x;
+		rrect.y = prect.h - region->y - region->height;
+		rrect.w = region->width;
+		rrect.h = region->height;
+	} else {
+		rrect = prect;
+	}
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+					      rrect.w, rrect.h);
+
+	rowstride = cairo_image_surface_get_stride (surface);
+	pixels = (gchar *)cairo_image_surface_get_data (surface);
 
 	ddjvu_page_set_rotation (d_page, rotation);
 	
@@ -406,6 +762,21 @@ djvu_document_render (EvDocument      *document,
 	return surface;
 }
 
+static cairo_surface_t *
+djvu_document_render (EvDocument      *document,
+		      EvRenderContext *rc)
+{
+	return djvu_document_render_internal (document, rc, NULL);
+}
+
+static cairo_surface_t *
+djvu_document_render_region (EvDocument            *document,
+			     EvRenderContext       *rc,
+			     cairo_rectangle_int_t *region)
+{
+	return djvu_document_render_internal (document, rc, region);
+}
+
 static char *
 djvu_document_get_page_label (EvDocument *document,
                               EvPage     *page)
@@ -519,6 +890,19 @@ djvu_document_finalize (GObject *object)
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (object);
 
+	djvu_document_clear_pages (djvu_document);
+	g_hash_table_destroy (djvu_document->d_pages);
+
+	g_debug ("DjVu text page cache: %u hits, %u misses",
+		 djvu_document->text_pages_hits,
+		 djvu_document->text_pages_misses);
+	djvu_document_clear_text_pages (djvu_document);
+	g_hash_table_destroy (djvu_document->text_pages);
+
+	djvu_document_clear_provisional_sizes (djvu_document);
+	g_array_free (djvu_document->refined_sizes, TRUE);
+	g_mutex_clear (&djvu_document->sizes_lock);
+
 	if (djvu_document->d_document)
 	    ddjvu_document_release (djvu_document->d_document);
 	    
@@ -556,6 +940,7 @@ djvu_document_class_init (DjvuDocumentClass *klass)
 	ev_document_class->get_page_label = djvu_document_get_page_label;
 	ev_document_class->get_page_size = djvu_document_get_page_size;
 	ev_document_class->render = djvu_document_render;
+	ev_document_class->render_region = djvu_document_render_region;
 	ev_document_class->get_thumbnail = djvu_document_get_thumbnail;
 	ev_document_class->get_thumbnail_surface = djvu_document_get_thumbnail_surface;
 }
@@ -568,17 +953,12 @@ djvu_text_copy (DjvuDocument *djvu_document,
 	miniexp_t page_text;
 	gchar    *text = NULL;
 
-	while ((page_text =
-		ddjvu_document_get_pagetext (djvu_document->d_document,
-					     page_num, "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
-
+	page_text = djvu_document_get_page_text (djvu_document, page_num);
 	if (page_text != miniexp_nil) {
 		DjvuTextPage *page = djvu_text_page_new (page_text);
 		
 		text = djvu_text_page_copy (page, rectangle);
 		djvu_text_page_free (page);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
 	}
 
 	return text;
@@ -609,16 +989,12 @@ djvu_selection_get_selection_rects (DjvuDocument    *djvu_document,
 
 	djvu_convert_to_doc_rect (&rectangle, points, height, dpi);
 
-	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page, "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
-
+	page_text = djvu_document_get_page_text (djvu_document, page);
 	if (page_text != miniexp_nil) {
 		DjvuTextPage *tpage = djvu_text_page_new (page_text);
 
 		rects = djvu_text_page_get_selection_region (tpage, &rectangle);
 		djvu_text_page_free (tpage);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
 	}
 
 	return rects;
@@ -729,24 +1105,11 @@ djvu_document_text_get_text (EvDocumentText  *selection,
                              EvPage          *page)
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (selection);
-	miniexp_t     page_text;
-	gchar        *text = NULL;
-
-	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page->index,
-							 "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
+	DjvuTextPage *tpage;
 
-	if (page_text != miniexp_nil) {
-		DjvuTextPage *tpage = djvu_text_page_new (page_text);
+	tpage = djvu_document_get_text_page (djvu_document, page->index, TRUE);
 
-		djvu_text_page_index_text (tpage, TRUE);
-		text = tpage->text;
-		tpage->text = NULL;
-		djvu_text_page_free (tpage);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
-	}
-	return text;
+	return tpage ? g_strdup (tpage->text) : NULL;
 }
 
 static void
@@ -839,6 +1202,18 @@ djvu_document_init (DjvuDocument *djvu_document)
 	djvu_document->opts = g_string_new ("");
 	
 	djvu_document->d_document = NULL;
+
+	djvu_document->d_pages = g_hash_table_new_full (g_direct_hash,
+							g_direct_equal,
+							NULL,
+							(GDestroyNotify)djvu_page_cache_entry_free);
+	g_queue_init (&djvu_document->d_pages_lru);
+
+	djvu_document->text_pages = g_hash_table_new (g_direct_hash, g_direct_equal);
+	g_queue_init (&djvu_document->text_pages_lru);
+
+	g_mutex_init (&djvu_document->sizes_lock);
+	djvu_document->refined_sizes = g_array_new (FALSE, FALSE, sizeof (DjvuPageSize));
 }
 
 static GList *
@@ -848,27 +1223,18 @@ djvu_document_find_find_text (EvDocumentFind   *document,
 			      gboolean          case_sensitive)
 {
         DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
-	miniexp_t page_text;
+	DjvuTextPage *tpage;
 	gdouble width, height, dpi;
 	GList *matches = NULL, *l;
 
 	g_return_val_if_fail (text != NULL, NULL);
 
-	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page->index,
-							 "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
-
-	if (page_text != miniexp_nil) {
-		DjvuTextPage *tpage = djvu_text_page_new (page_text);
-		
-		djvu_text_page_index_text (tpage, case_sensitive);
-		if (tpage->links->len > 0) {
-			djvu_text_page_search (tpage, text);
-			matches = tpage->results;
-		}
-		djvu_text_page_free (tpage);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
+	tpage = djvu_document_get_text_page (djvu_document, page->index,
+					     case_sensitive);
+	if (tpage && tpage->links->len > 0) {
+		djvu_text_page_search (tpage, text);
+		matches = tpage->results;
+		tpage->results = NULL;
 	}
 	if (!matches)
 		return NULL;
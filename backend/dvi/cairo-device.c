@@ -19,6 +19,7 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <gdk/gdk.h>
 #ifdef HAVE_SPECTRE
 #include <libspectre/spectre.h>
@@ -40,6 +41,156 @@ typedef struct {
 
 } DviCairoDevice;
 
+/* Maximum size in bytes of the scaled glyphs kept by the glyph cache */
+#define DVI_GLYPH_CACHE_SIZE (8 * 1024 * 1024)
+
+typedef struct {
+	gchar *fontname;
+	gint   hdpi;
+	gint   vdpi;
+	gint   code;
+	gint   hshrink;
+	gint   vshrink;
+	Ulong  fg;
+	Ulong  bg;
+} DviGlyphKey;
+
+typedef struct {
+	DviGlyphKey key;
+	DviGlyph    glyph;
+	gsize       size;
+	GList      *link;
+} DviCachedGlyph;
+
+/* Scaled glyphs of all fonts and documents, most recently used first.
+ * Only used from font_get_glyph(), with the font lock held.
+ */
+static GHashTable *glyph_cache = NULL;
+static GQueue      glyph_cache_lru = G_QUEUE_INIT;
+static gsize       glyph_cache_size = 0;
+
+static guint
+dvi_glyph_key_hash (gconstpointer v)
+{
+	const DviGlyphKey *key = v;
+
+	return g_str_hash (key->fontname) ^
+		(key->code << 16) ^ (key->hdpi << 4) ^ key->vdpi ^
+		(key->hshrink << 24) ^ (key->vshrink << 20) ^
+		key->fg ^ key->bg;
+}
+
+static gboolean
+dvi_glyph_key_equal (gconstpointer a,
+		     gconstpointer b)
+{
+	const DviGlyphKey *ka = a;
+	const DviGlyphKey *kb = b;
+
+	return ka->code == kb->code &&
+		ka->hdpi == kb->hdpi && ka->vdpi == kb->vdpi &&
+		ka->hshrink == kb->hshrink && ka->vshrink == kb->vshrink &&
+		ka->fg == kb->fg && ka->bg == kb->bg &&
+		strcmp (ka->fontname, kb->fontname) == 0;
+}
+
+static void
+dvi_cached_glyph_free (DviCachedGlyph *cached)
+{
+	cairo_surface_destroy ((cairo_surface_t *)cached->glyph.data);
+	g_free (cached->key.fontname);
+	g_slice_free (DviCachedGlyph, cached);
+}
+
+static void
+dvi_glyph_key_init (DviGlyphKey *key,
+		    DviContext  *dvi,
+		    DviFont     *font,
+		    gint         code)
+{
+	key->fontname = font->fontname;
+	key->hdpi = font->hdpi;
+	key->vdpi = font->vdpi;
+	key->code = code;
+	key->hshrink = dvi->params.hshrink;
+	key->vshrink = dvi->params.vshrink;
+	key->fg = dvi->curr_fg;
+	key->bg = dvi->curr_bg;
+}
+
+static int
+dvi_cairo_lookup_glyph (DviContext *dvi,
+			DviFont    *font,
+			int         code,
+			DviGlyph   *glyph)
+{
+	DviGlyphKey     key;
+	DviCachedGlyph *cached;
+
+	if (!glyph_cache)
+		return 0;
+
+	dvi_glyph_key_init (&key, dvi, font, code);
+	cached = g_hash_table_lookup (glyph_cache, &key);
+	if (!cached)
+		return 0;
+
+	g_queue_unlink (&glyph_cache_lru, cached->link);
+	g_queue_push_head_link (&glyph_cache_lru, cached->link);
+
+	*glyph = cached->glyph;
+	glyph->data = cairo_surface_reference ((cairo_surface_t *)cached->glyph.data);
+
+	return 1;
+}
+
+static void
+dvi_cairo_cache_glyph (DviContext *dvi,
+		       DviFont    *font,
+		       int         code,
+		       DviGlyph   *glyph)
+{
+	DviCachedGlyph  *cached;
+	cairo_surface_t *surface;
+	gsize            size;
+
+	surface = (cairo_surface_t *)glyph->data;
+	size = cairo_image_surface_get_stride (surface) *
+		cairo_image_surface_get_height (surface);
+	if (size > DVI_GLYPH_CACHE_SIZE)
+		return;
+
+	if (!glyph_cache) {
+		glyph_cache = g_hash_table_new (dvi_glyph_key_hash,
+						dvi_glyph_key_equal);
+	}
+
+	cached = g_slice_new (DviCachedGlyph);
+	dvi_glyph_key_init (&cached->key, dvi, font, code);
+	if (g_hash_table_lookup (glyph_cache, &cached->key)) {
+		g_slice_free (DviCachedGlyph, cached);
+		return;
+	}
+	cached->key.fontname = g_strdup (font->fontname);
+	cached->glyph = *glyph;
+	cached->glyph.data = cairo_surface_reference (surface);
+	cached->size = size;
+
+	g_hash_table_insert (glyph_cache, &cached->key, cached);
+	g_queue_push_head (&glyph_cache_lru, cached);
+	cached->link = glyph_cache_lru.head;
+	glyph_cache_size += size;
+
+	while (glyph_cache_size > DVI_GLYPH_CACHE_SIZE) {
+		DviCachedGlyph *last;
+
+		last = g_queue_pop_tail (&glyph_cache_lru);
+		g_hash_table_remove (glyph_cache, &last->key);
+		glyph_cache_size -= last->size;
+		dvi_cached_glyph_free (last);
+	}
+}
+
 static void
 dvi_cairo_draw_glyph (DviContext  *dvi,
 		      DviFontChar *ch,
@@ -242,6 +393,12 @@ dvi_cairo_free_image (void *ptr)
 	cairo_surface_destroy ((cairo_surface_t *)ptr);
 }
 
+static void *
+dvi_cairo_ref_image (void *ptr)
+{
+	return cairo_surface_reference ((cairo_surface_t *)ptr);
+}
+
 static void
 dvi_cairo_put_pixel (void *image, int x, int y, Ulong color)
 {
@@ -285,6 +442,7 @@ mdvi_cairo_device_init (DviDevice *device)
 	device->alloc_colors = dvi_cairo_alloc_colors;
 	device->create_image = dvi_cairo_create_image;
 	device->free_image = dvi_cairo_free_image;
+	device->ref_image = dvi_cairo_ref_image;
 	device->put_pixel = dvi_cairo_put_pixel;
         device->image_done = dvi_cairo_image_done;
 	device->set_color = dvi_cairo_set_color;
@@ -293,6 +451,8 @@ mdvi_cairo_device_init (DviDevice *device)
 #else
 	device->draw_ps = NULL;
 #endif
+	device->lookup_glyph = dvi_cairo_lookup_glyph;
+	device->cache_glyph = dvi_cairo_cache_glyph;
 	device->refresh = NULL;
 }
 
@@ -40,7 +40,8 @@
 #endif
 #include <stdlib.h>
 
-static GMutex dvi_context_mutex;
+/* Fonts and their glyphs are shared by the contexts of all documents */
+static GMutex dvi_font_mutex;
 
 enum {
 	PROP_0,
@@ -58,6 +59,10 @@ struct _DviDocument
 
 	DviContext *context;
 	DviPageSpec *spec;
+
+	/* Clones of context not rendering a page right now */
+	GMutex  contexts_mutex;
+	GSList *idle_contexts;
 	DviParams *params;
 	
 	/* To let document scale we should remember width and height */
@@ -83,6 +88,74 @@ EV_BACKEND_REGISTER_WITH_CODE (DviDocument, dvi_document,
       EV_BACKEND_IMPLEMENT_INTERFACE (EV_TYPE_FILE_EXPORTER, dvi_document_file_exporter_iface_init);
      });
 
+static void
+dvi_font_lock (void)
+{
+	g_mutex_lock (&dvi_font_mutex);
+}
+
+static void
+dvi_font_unlock (void)
+{
+	g_mutex_unlock (&dvi_font_mutex);
+}
+
+static void
+dvi_document_free_context (DviContext *context)
+{
+	mdvi_cairo_device_free (&context->device);
+	mdvi_destroy_context (context);
+}
+
+static void
+dvi_document_clear_contexts (DviDocument *dvi_document)
+{
+	g_mutex_lock (&dvi_document->contexts_mutex);
+	g_slist_free_full (dvi_document->idle_contexts,
+			   (GDestroyNotify)dvi_document_free_context);
+	dvi_document->idle_contexts = NULL;
+	g_mutex_unlock (&dvi_document->contexts_mutex);
+
+	if (dvi_document->context) {
+		g_mutex_lock (&dvi_font_mutex);
+		dvi_document_free_context (dvi_document->context);
+		g_mutex_unlock (&dvi_font_mutex);
+		dvi_document->context = NULL;
+	}
+}
+
+/* Every page is rendered with a clone of the document context, so that
+ * different pages and scales can be rendered at the same time. Clones
+ * are cheap, they share the fonts and page table of the document context.
+ */
+static DviContext *
+dvi_document_get_render_context (DviDocument *dvi_document)
+{
+	DviContext *context;
+
+	g_mutex_lock (&dvi_document->contexts_mutex);
+	if (dvi_document->idle_contexts) {
+		context = dvi_document->idle_contexts->data;
+		dvi_document->idle_contexts = g_slist_delete_link (dvi_document->idle_contexts,
+								   dvi_document->idle_contexts);
+	} else {
+		context = mdvi_clone_context (dvi_document->context);
+		mdvi_cairo_device_init (&context->device);
+	}
+	g_mutex_unlock (&dvi_document->contexts_mutex);
+
+	return context;
+}
+
+static void
+dvi_document_release_render_context (DviDocument *dvi_document,
+				     DviContext  *context)
+{
+	g_mutex_lock (&dvi_document->contexts_mutex);
+	dvi_document->idle_contexts = g_slist_prepend (dvi_document->idle_contexts, context);
+	g_mutex_unlock (&dvi_document->contexts_mutex);
+}
+
 static gboolean
 dvi_document_load (EvDocument  *document,
 		   const char  *uri,
@@ -95,12 +168,12 @@ dvi_document_load (EvDocument  *document,
 	if (!filename)
         	return FALSE;
 	
-	g_mutex_lock (&dvi_context_mutex);
-	if (dvi_document->context)
-		mdvi_destroy_context (dvi_document->context);
+	dvi_document_clear_contexts (dvi_document);
 
+	g_mutex_lock (&dvi_font_mutex);
 	dvi_document->context = mdvi_init_context(dvi_document->params, dvi_document->spec, filename);
-	g_mutex_unlock (&dvi_context_mutex);
+	mdvi_save_font_cache ();
+	g_mutex_unlock (&dvi_font_mutex);
 	g_free (filename);
 	
 	if (!dvi_document->context) {
@@ -111,6 +184,7 @@ dvi_document_load (EvDocument  *document,
         	return FALSE;
 	}
 	
+	/* Not used for rendering, but frees the glyphs of unused fonts */
 	mdvi_cairo_device_init (&dvi_document->context->device);
 	
 	
@@ -164,41 +238,38 @@ dvi_document_render (EvDocument      *document,
 	cairo_surface_t *surface;
 	cairo_surface_t *rotated_surface;
 	DviDocument *dvi_document = DVI_DOCUMENT(document);
+	DviContext *context;
 	gdouble xscale, yscale;
 	gint required_width, required_height;
 	gint proposed_width, proposed_height;
 	gint xmargin = 0, ymargin = 0;
 
-	/* We should protect our context since it's not 
-	 * thread safe. The work to the future - 
-	 * let context render page independently
-	 */
-	g_mutex_lock (&dvi_context_mutex);
+	context = dvi_document_get_render_context (dvi_document);
 	
-	mdvi_setpage (dvi_document->context, rc->page->index);
+	mdvi_setpage (context, rc->page->index);
 	
 	ev_render_context_compute_scales (rc, dvi_document->base_width, dvi_document->base_height,
 					  &xscale, &yscale);
-	mdvi_set_shrink (dvi_document->context, 
+	mdvi_set_shrink (context, 
 			 (int)((dvi_document->params->hshrink - 1) / xscale) + 1,
 			 (int)((dvi_document->params->vshrink - 1) / yscale) + 1);
 
 	ev_render_context_compute_scaled_size (rc, dvi_document->base_width, dvi_document->base_height,
 					       &required_width, &required_height);
-	proposed_width = dvi_document->context->dvi_page_w * dvi_document->context->params.conv;
-	proposed_height = dvi_document->context->dvi_page_h * dvi_document->context->params.vconv;
+	proposed_width = context->dvi_page_w * context->params.conv;
+	proposed_height = context->dvi_page_h * context->params.vconv;
 	
 	if (required_width >= proposed_width)
 	    xmargin = (required_width - proposed_width) / 2;
 	if (required_height >= proposed_height)
 	    ymargin = (required_height - proposed_height) / 2;
 	    
-	mdvi_cairo_device_set_margins (&dvi_document->context->device, xmargin, ymargin);
-	mdvi_cairo_device_set_scale (&dvi_document->context->device, xscale, yscale);
-	mdvi_cairo_device_render (dvi_document->context);
-	surface = mdvi_cairo_device_get_surface (&dvi_document->context->device);
+	mdvi_cairo_device_set_margins (&context->device, xmargin, ymargin);
+	mdvi_cairo_device_set_scale (&context->device, xscale, yscale);
+	mdvi_cairo_device_render (context);
+	surface = mdvi_cairo_device_get_surface (&context->device);
 
-	g_mutex_unlock (&dvi_context_mutex);
+	dvi_document_release_render_context (dvi_document, context);
 
 	rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
 								     required_width,
@@ -214,12 +285,8 @@ dvi_document_finalize (GObject *object)
 {	
 	DviDocument *dvi_document = DVI_DOCUMENT(object);
 	
-	g_mutex_lock (&dvi_context_mutex);
-	if (dvi_document->context) {
-		mdvi_cairo_device_free (&dvi_document->context->device);
-		mdvi_destroy_context (dvi_document->context);
-	}
-	g_mutex_unlock (&dvi_context_mutex);
+	dvi_document_clear_contexts (dvi_document);
+	g_mutex_clear (&dvi_document->contexts_mutex);
 
 	if (dvi_document->params)
 		g_free (dvi_document->params);
@@ -247,6 +314,7 @@ dvi_document_class_init (DviDocumentClass *klass)
 	GObjectClass    *gobject_class = G_OBJECT_CLASS (klass);
 	EvDocumentClass *ev_document_class = EV_DOCUMENT_CLASS (klass);
 	gchar *texmfcnf;
+	gchar *cache_dir;
 
 	gobject_class->finalize = dvi_document_finalize;
 
@@ -254,8 +322,22 @@ dvi_document_class_init (DviDocumentClass *klass)
 	mdvi_init_kpathsea ("evince", MDVI_MFMODE, MDVI_FALLBACK_FONT, MDVI_DPI, texmfcnf);
 	g_free(texmfcnf);
 
+	/* Font lookups are saved so that kpathsea doesn't need to
+	 * load its databases when the fonts are already known
+	 */
+	cache_dir = g_build_filename (g_get_user_cache_dir (), "evince", NULL);
+	if (g_mkdir_with_parents (cache_dir, 0700) == 0) {
+		gchar *font_cache;
+
+		font_cache = g_build_filename (cache_dir, "dvi-fonts", NULL);
+		mdvi_init_font_cache (font_cache);
+		g_free (font_cache);
+	}
+	g_free (cache_dir);
+
 	mdvi_register_special ("Color", "color", NULL, dvi_document_do_color_special, 1);
 	mdvi_register_fonts ();
+	mdvi_set_font_lock (dvi_font_lock, dvi_font_unlock);
 
 	ev_document_class->load = dvi_document_load;
 	ev_document_class->save = dvi_document_save;
@@ -518,6 +600,8 @@ static void
 dvi_document_init (DviDocument *dvi_document)
 {
 	dvi_document->context = NULL;
+	g_mutex_init (&dvi_document->contexts_mutex);
+	dvi_document->idle_contexts = NULL;
 	dvi_document_init_params (dvi_document);
 
 	dvi_document->exporter_filename = NULL;
@@ -469,6 +469,10 @@ int	mdvi_reload(DviContext *dvi, DviParams *np)
 	DviContext *newdvi;
 	DviParams  *pars;
 	
+	/* clones can only follow their parent */
+	if(dvi->parent)
+		return -1;
+
 	/* close our file */
 	if(dvi->in) {
 		fclose(dvi->in);
@@ -564,15 +568,12 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 			break;
 		case MDVI_SET_SHRINK:
 			np.hshrink = np.vshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_XSHRINK:
 			np.hshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_YSHRINK:
 			np.vshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_ORIENTATION:
 			np.orientation = va_arg(ap, DviOrientation);
@@ -647,8 +648,14 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 			np.vconv /= np.vshrink;
 	}
 
+	/* 
+	 * Scaled glyphs made with other shrink factors are redone by
+	 * font_get_glyph(), so changing them does not reset the fonts.
+	 */
 	if(reset_font) {
+		font_lock();
 		font_reset_chain_glyphs(&dvi->device, dvi->fonts, reset_font);
+		font_unlock();
 	}
 	dvi->params = np;	
 	if((reset_font & MDVI_FONTSEL_GLYPH) && dvi->device.refresh) {
@@ -891,6 +898,7 @@ DviContext *mdvi_init_context(DviParams *par, DviPageSpec *spec, const char *fil
 	dvi->device.alloc_colors = dummy_alloc_colors;
 	dvi->device.create_image = dummy_create_image;
 	dvi->device.free_image   = dummy_free_image;
+	dvi->device.ref_image    = NULL;
 	dvi->device.dev_destroy  = dummy_dev_destroy;
 	dvi->device.put_pixel    = dummy_dev_putpixel;
 	dvi->device.refresh      = dummy_dev_refresh;
@@ -909,10 +917,56 @@ error:
 	return NULL;
 }
 
+/*
+ * Make a context that renders the same file as `dvi', sharing its fonts,
+ * font map and page table, but with its own file handle, buffer, stacks
+ * and device. Different clones can render pages at the same time, as long
+ * as the client registered font locking functions with mdvi_set_font_lock().
+ * The parent must not be reloaded or destroyed before its clones.
+ */
+DviContext *mdvi_clone_context(DviContext *dvi)
+{
+	DviContext *clone;
+
+	clone = xalloc(DviContext);
+	memcpy(clone, dvi, sizeof(DviContext));
+	clone->parent = dvi;
+	clone->in = NULL; /* reopened by mdvi_dopage() */
+	clone->depth = 0;
+	clone->currfont = NULL;
+	clone->buffer.data = NULL;
+	clone->buffer.length = 0;
+	clone->buffer.pos = 0;
+	clone->buffer.frozen = 0;
+	clone->stack = xnalloc(DviState, dvi->stacksize + 8);
+	clone->stacktop = 0;
+	clone->curr_fg = dvi->params.fg;
+	clone->curr_bg = dvi->params.bg;
+	clone->color_stack = NULL;
+	clone->color_top = 0;
+	clone->color_size = 0;
+	memzero(&clone->device, sizeof(DviDevice));
+
+	return clone;
+}
+
 void	mdvi_destroy_context(DviContext *dvi)
 {
 	if(dvi->device.dev_destroy)
 		dvi->device.dev_destroy(dvi->device.device_data);
+	if(dvi->parent) {
+		/* everything else belongs to the parent */
+		if(dvi->stack)
+			mdvi_free(dvi->stack);
+		if(dvi->in)
+			fclose(dvi->in);
+		if(dvi->buffer.data && !dvi->buffer.frozen)
+			mdvi_free(dvi->buffer.data);
+		if(dvi->color_stack)
+			mdvi_free(dvi->color_stack);
+		mdvi_free(dvi);
+		return;
+	}
 	/* release all fonts */
 	if(dvi->fonts) {
 		font_drop_chain(dvi->fonts);
@@ -1019,7 +1073,8 @@ again:
 	}
 	
 	/* check if we need to reload the file */
-	if(!reloaded && get_mtime(fileno(dvi->in)) > dvi->modtime) {
+	if(!reloaded && !dvi->parent && 
+	   get_mtime(fileno(dvi->in)) > dvi->modtime) {
 		mdvi_reload(dvi, &dvi->params);
 		/* we have to reopen the file, again */
 		reloaded = 1;
@@ -1246,7 +1301,9 @@ int	set_char(DviContext *dvi, int opcode)
 	int	num;
 	int	h;
 	int	hh;
+	Int32	tfmwidth;
 	DviFontChar *ch;
+	DviFontChar glyph;
 	DviFont	*font;
 	
 	if(opcode < 128)
@@ -1258,11 +1315,13 @@ int	set_char(DviContext *dvi, int opcode)
 		return -1;
 	}
 	font = dvi->currfont->ref;
+	font_lock();
 	ch = font_get_glyph(dvi, font, num);
 	if(ch == NULL || ch->missing) {
 		/* try to display something anyway */
 		ch = FONTCHAR(font, num);
 		if(!glyph_present(ch)) {
+			font_unlock();
 			dviwarn(dvi, 
 			_("requested character %d does not exist in `%s'\n"), 
 				num, font->fontname);
@@ -1270,23 +1329,48 @@ int	set_char(DviContext *dvi, int opcode)
 		}
 		draw_box(dvi, ch);
 	} else if(dvi->curr_layer <= dvi->params.layer) {
-		if(ISVIRTUAL(font))
+		if(ISVIRTUAL(font)) {
+			/* the macro sets characters of its own */
+			font_unlock();
 			mdvi_run_macro(dvi, (Uchar *)font->private + 
 				ch->offset, ch->width);
-		else if(ch->width && ch->height)
-			dvi->device.draw_glyph(dvi, ch, 
-				dvi->pos.hh, dvi->pos.vv);
+			font_lock();
+		} else if(ch->width && ch->height) {
+			/* 
+			 * Other contexts may redo the glyph once the lock is
+			 * released, so draw a copy of it holding a reference
+			 * to its image. Without a way to reference images,
+			 * draw it with the lock held.
+			 */
+			if(dvi->device.ref_image == NULL) {
+				dvi->device.draw_glyph(dvi, ch,
+					dvi->pos.hh, dvi->pos.vv);
+			} else {
+				glyph = *ch;
+				if(MDVI_GLYPH_NONEMPTY(glyph.grey.data))
+					glyph.grey.data = 
+						dvi->device.ref_image(glyph.grey.data);
+				font_unlock();
+				dvi->device.draw_glyph(dvi, &glyph,
+					dvi->pos.hh, dvi->pos.vv);
+				if(MDVI_GLYPH_NONEMPTY(glyph.grey.data))
+					dvi->device.free_image(glyph.grey.data);
+				font_lock();
+			}
+		}
 	}
+	tfmwidth = ch->tfmwidth;
+	font_unlock();
 	if(opcode >= DVI_PUT1 && opcode <= DVI_PUT4) {
 		SHOWCMD((dvi, "putchar", opcode - DVI_PUT1 + 1,
 			"char %d (%s)\n",
 			num, dvi->currfont->ref->fontname));
 	} else {
-		h = dvi->pos.h + ch->tfmwidth;
-		hh = dvi->pos.hh + pixel_round(dvi, ch->tfmwidth);
+		h = dvi->pos.h + tfmwidth;
+		hh = dvi->pos.hh + pixel_round(dvi, tfmwidth);
 		SHOWCMD((dvi, "setchar", num, "(%d,%d) h:=%d%c%d=%d, hh:=%d (%s)\n",
 			dvi->pos.hh, dvi->pos.vv,
-			DBGSUM(dvi->pos.h, ch->tfmwidth, h), hh,
+			DBGSUM(dvi->pos.h, tfmwidth, h), hh,
 			font->fontname));
 		dvi->pos.h  = h;
 		dvi->pos.hh = hh;
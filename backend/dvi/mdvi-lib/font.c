@@ -24,6 +24,9 @@
 
 static ListHead fontlist;
 
+static void (*font_lock_func) __PROTO((void)) = NULL;
+static void (*font_unlock_func) __PROTO((void)) = NULL;
+
 extern char *_mdvi_fallback_font;
 
 extern void vf_free_macros(DviFont *);
@@ -44,6 +47,29 @@ int	font_reopen(DviFont *font)
 	return 0;
 }
 
+/* 
+ * Fonts and their glyphs are shared by every context using them. Clients
+ * that render with several contexts at the same time register functions
+ * here to serialize access to them.
+ */
+void	mdvi_set_font_lock(void (*lock)(void), void (*unlock)(void))
+{
+	font_lock_func = lock;
+	font_unlock_func = unlock;
+}
+
+void	font_lock(void)
+{
+	if(font_lock_func)
+		font_lock_func();
+}
+
+void	font_unlock(void)
+{
+	if(font_unlock_func)
+		font_unlock_func();
+}
+
 /* used from context: params and device */
 static int load_font_file(DviParams *params, DviFont *font)
 {
@@ -366,6 +392,15 @@ again:
 	/* yes, we have to do this again */
 	ch = FONTCHAR(font, code);
 
+	/* the scaled glyphs may come from a context with other shrink factors */
+	if(ch->hshrink != dvi->params.hshrink || 
+	   ch->vshrink != dvi->params.vshrink) {
+		font_reset_one_glyph(&dvi->device, ch, 
+			MDVI_FONTSEL_BITMAP|MDVI_FONTSEL_GREY);
+		ch->hshrink = dvi->params.hshrink;
+		ch->vshrink = dvi->params.vshrink;
+	}
+
 	/* Got the glyph. If we also have the right scaled glyph, do no more */
 	if(!ch->width || !ch->height ||
 	   font->finfo->getglyph == NULL ||
@@ -389,7 +424,16 @@ again:
 				dvi->device.free_image(ch->grey.data);
 			ch->grey.data = NULL;
 		}
+		if(dvi->device.lookup_glyph &&
+		   dvi->device.lookup_glyph(dvi, font, code, &ch->grey)) {
+			ch->fg = dvi->curr_fg;
+			ch->bg = dvi->curr_bg;
+			return ch;
+		}
 		font->finfo->shrink1(dvi, font, ch, &ch->grey);
+		if(dvi->device.cache_glyph &&
+		   MDVI_GLYPH_NONEMPTY(ch->grey.data))
+			dvi->device.cache_glyph(dvi, font, code, &ch->grey);
 	} else if(!ch->shrunk.data)
 		font->finfo->shrink0(dvi, font, ch, &ch->shrunk);
 
@@ -48,11 +48,19 @@
  */
 
 #include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "mdvi.h"
 
 #define HAVE_PROTOTYPES 1
 #include <kpathsea/tex-file.h>
 #include <kpathsea/tex-glyph.h>
+#include <kpathsea/variable.h>
+#include <kpathsea/expand.h>
+#include <kpathsea/pathsearch.h>
 
 struct _DviFontClass {
 	DviFontClass *next;
@@ -69,6 +77,32 @@ char *_mdvi_fallback_font = MDVI_FALLBACK_FONT;
 static ListHead font_classes[MAX_CLASS];
 static int initialized = 0;
 
+/*
+ * Successful results of lookup_font(), saved to disk so that kpathsea
+ * does not have to load its ls-R databases at all when all the fonts of
+ * a file were found before. The cache is discarded when any of the ls-R
+ * files changes. Failed lookups are not kept: fonts installed later into
+ * trees without an ls-R (TEXMFHOME, VARTEXFONTS) must still be found.
+ */
+typedef struct _FontCacheEntry FontCacheEntry;
+struct _FontCacheEntry {
+	FontCacheEntry *next;
+	FontCacheEntry *prev;
+	char	*key;
+	char	*filename;	/* NULL if the font is gone */
+	Ushort	hdpi;
+	Ushort	vdpi;
+};
+
+#define FONT_CACHE_HASH_SIZE	131
+#define FONT_CACHE_VERSION	"mdvi-font-cache 2"
+
+static DviHashTable font_cache = MDVI_EMPTY_HASH_TABLE;
+static ListHead font_cache_entries;
+static char	*font_cache_file = NULL;
+static char	*font_cache_stamp = NULL;
+static int	font_cache_dirty = 0;
+
 static void init_font_classes(void)
 {
 	int	i;
@@ -166,9 +200,227 @@ int	mdvi_unregister_font_type(const char *name, int klass)
 	return 0;
 }
 
+static char *font_cache_key(DviFontClass *ptr, const char *name, 
+	Ushort h, Ushort v)
+{
+	char	*key;
+
+	key = mdvi_malloc(strlen(ptr->info.name) + strlen(name) + 24);
+	sprintf(key, "%s %s %u %u", ptr->info.name, name, h, v);
+	return key;
+}
+
+static FontCacheEntry *font_cache_add(char *key, const char *filename,
+	Ushort h, Ushort v)
+{
+	FontCacheEntry *entry;
+
+	entry = xalloc(FontCacheEntry);
+	entry->key = key;
+	entry->filename = filename ? mdvi_strdup(filename) : NULL;
+	entry->hdpi = h;
+	entry->vdpi = v;
+	listh_append(&font_cache_entries, LIST(entry));
+	mdvi_hash_add(&font_cache, MDVI_KEY(key), entry, MDVI_HASH_UNCHECKED);
+	return entry;
+}
+
+static void font_cache_reset(void)
+{
+	FontCacheEntry *entry;
+
+	if(font_cache.nbucks)
+		mdvi_hash_reset(&font_cache, 0);
+	while((entry = (FontCacheEntry *)font_cache_entries.head)) {
+		listh_remove(&font_cache_entries, LIST(entry));
+		mdvi_free(entry->key);
+		if(entry->filename)
+			mdvi_free(entry->filename);
+		mdvi_free(entry);
+	}
+}
+
+/* the modification times of the ls-R files kpathsea searches */
+static char *font_cache_get_stamp(void)
+{
+	Dstring	stamp;
+	char	*dbs;
+	char	*path;
+	char	*dir;
+	char	*result;
+
+	dstring_init(&stamp);
+	dstring_strcat(&stamp, FONT_CACHE_VERSION);
+
+	dbs = kpse_var_value("TEXMFDBS");
+	path = dbs ? kpse_path_expand(dbs) : NULL;
+	for(dir = path ? kpse_path_element(path) : NULL; dir; 
+	    dir = kpse_path_element(NULL)) {
+		static const char *names[] = { "ls-R", "ls-r" };
+		char	buffer[64];
+		int	i;
+
+		for(i = 0; i < 2; i++) {
+			struct stat st;
+			char	*file;
+
+			file = mdvi_malloc(strlen(dir) + strlen(names[i]) + 2);
+			sprintf(file, "%s/%s", dir, names[i]);
+			if(stat(file, &st) == 0) {
+				sprintf(buffer, " %lu:%lu:", 
+					(Ulong)st.st_mtime, (Ulong)st.st_size);
+				dstring_strcat(&stamp, buffer);
+				dstring_strcat(&stamp, file);
+			}
+			mdvi_free(file);
+		}
+	}
+	if(path)
+		mdvi_free(path);
+	if(dbs)
+		mdvi_free(dbs);
+
+	result = mdvi_strdup(stamp.data);
+	dstring_reset(&stamp);
+	return result;
+}
+
+/*
+ * Use `file' to keep the results of font lookups across runs. Entries are
+ * read from it if it is still valid; new ones are only written to it by
+ * mdvi_save_font_cache().
+ */
+int	mdvi_init_font_cache(const char *file)
+{
+	FILE	*in;
+	Dstring	input;
+	char	*line;
+
+	if(font_cache_file) {
+		font_cache_reset();
+		mdvi_free(font_cache_file);
+		mdvi_free(font_cache_stamp);
+	}
+	font_cache_file = mdvi_strdup(file);
+	font_cache_stamp = font_cache_get_stamp();
+	font_cache_dirty = 0;
+	mdvi_hash_create(&font_cache, FONT_CACHE_HASH_SIZE);
+	listh_init(&font_cache_entries);
+
+	in = fopen(file, "rb");
+	if(in == NULL)
+		return 0;
+
+	dstring_init(&input);
+	line = dgets(&input, in);
+	if(line == NULL || !STREQ(line, font_cache_stamp)) {
+		DEBUG((DBG_FONTS, "%s: font cache out of date\n", file));
+		dstring_reset(&input);
+		fclose(in);
+		font_cache_dirty = 1;
+		return 0;
+	}
+	while((line = dgets(&input, in)) != NULL) {
+		char	*key;
+		char	*filename;
+		char	*h, *v;
+		char	*end;
+		Ulong	hdpi, vdpi;
+
+		key = line;
+		if((filename = strchr(key, '\t')) == NULL)
+			continue;
+		*filename++ = 0;
+		if((h = strchr(filename, '\t')) == NULL)
+			continue;
+		*h++ = 0;
+		if((v = strchr(h, '\t')) == NULL)
+			continue;
+		*v++ = 0;
+		if(*filename == 0 || strchr(v, '\t') == NULL)
+			continue;
+		*strchr(v, '\t') = 0;
+		hdpi = strtoul(h, &end, 10);
+		if(*h == 0 || *end != 0 || hdpi == 0 || hdpi > 0xffff)
+			continue;
+		vdpi = strtoul(v, &end, 10);
+		if(*v == 0 || *end != 0 || vdpi == 0 || vdpi > 0xffff)
+			continue;
+		if(mdvi_hash_lookup(&font_cache, MDVI_KEY(key)))
+			continue;
+		font_cache_add(mdvi_strdup(key), filename, hdpi, vdpi);
+	}
+	dstring_reset(&input);
+	fclose(in);
+	DEBUG((DBG_FONTS, "%s: %d cached font lookups\n", 
+		file, font_cache.nkeys));
+	return 0;
+}
+
+/* write the lookups done since the cache was read, if any */
+int	mdvi_save_font_cache(void)
+{
+	FontCacheEntry *entry;
+	FILE	*out;
+	char	*tmpfile;
+	int	fd;
+	int	status = 0;
+
+	if(font_cache_file == NULL || !font_cache_dirty)
+		return 0;
+
+	/* other processes may be saving the cache at the same time */
+	tmpfile = mdvi_malloc(strlen(font_cache_file) + 8);
+	sprintf(tmpfile, "%s.XXXXXX", font_cache_file);
+	fd = mkstemp(tmpfile);
+	if(fd < 0) {
+		mdvi_free(tmpfile);
+		return -1;
+	}
+	out = fdopen(fd, "wb");
+	if(out == NULL) {
+		close(fd);
+		unlink(tmpfile);
+		mdvi_free(tmpfile);
+		return -1;
+	}
+	fprintf(out, "%s\n", font_cache_stamp);
+	for(entry = (FontCacheEntry *)font_cache_entries.head; entry; 
+	    entry = entry->next) {
+		if(entry->filename == NULL || 
+		   strpbrk(entry->filename, "\t\n"))
+			continue;
+		/* the trailing tab marks a complete line */
+		fprintf(out, "%s\t%s\t%u\t%u\t\n", entry->key,
+			entry->filename, entry->hdpi, entry->vdpi);
+	}
+	if(fclose(out) != 0 || rename(tmpfile, font_cache_file) < 0) {
+		unlink(tmpfile);
+		status = -1;
+	} else
+		font_cache_dirty = 0;
+	mdvi_free(tmpfile);
+	return status;
+}
+
 static char *lookup_font(DviFontClass *ptr, const char *name, Ushort *h, Ushort *v)
 {
 	char	*filename;
+	char	*key = NULL;
+	FontCacheEntry *entry = NULL;
+
+	if(font_cache_file) {
+		key = font_cache_key(ptr, name, *h, *v);
+		entry = mdvi_hash_lookup(&font_cache, MDVI_KEY(key));
+		/* files found before may have been removed since */
+		if(entry && entry->filename && 
+		   access(entry->filename, R_OK) == 0) {
+			mdvi_free(key);
+			*h = entry->hdpi;
+			*v = entry->vdpi;
+			return mdvi_strdup(entry->filename);
+		}
+	}
 
 	/*
 	 * If the font type registered a function to do the lookup, use that. 
@@ -189,6 +441,21 @@ static char *lookup_font(DviFontClass *ptr, const char *name, Ushort *h, Ushort
 			*h = *v = type.dpi;
 	} else
 		filename = kpse_find_file(name, ptr->info.kpse_type, 1);
+
+	if(key && entry) {
+		/* stale entry, dropped on save if the font is gone */
+		mdvi_free(key);
+		if(entry->filename)
+			mdvi_free(entry->filename);
+		entry->filename = filename ? mdvi_strdup(filename) : NULL;
+		entry->hdpi = *h;
+		entry->vdpi = *v;
+		font_cache_dirty = 1;
+	} else if(key && filename) {
+		font_cache_add(key, filename, *h, *v);
+		font_cache_dirty = 1;
+	} else if(key)
+		mdvi_free(key);
 	return filename;
 }
 
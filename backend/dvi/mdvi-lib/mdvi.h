@@ -98,6 +98,8 @@ typedef void *(*DviCreateImage)	__PROTO((void *device_data,
 				         Uint height,
 				         Uint bpp));
 typedef void (*DviFreeImage)	__PROTO((void *image));
+/* Optional, returns a new reference to @image, released with free_image */
+typedef void *(*DviRefImage)	__PROTO((void *image));
 typedef void (*DviPutPixel)	__PROTO((void *image, int x, int y, Ulong color));
 typedef void (*DviImageDone)    __PROTO((void *image));
 typedef void (*DviDevDestroy)   __PROTO((void *data));
@@ -107,6 +109,17 @@ typedef void (*DviPSDraw)       __PROTO((DviContext *context,
 					 const char *filename, 
 					 int x, int y,
 					 Uint width, Uint height));
+/* 
+ * Optional cache of the scaled glyphs, shared by all fonts. The lookup
+ * function returns nonzero and fills the glyph if it has the glyph at the
+ * context's shrink factors and colors.
+ */
+typedef int (*DviLookupGlyph)	__PROTO((DviContext *context,
+					 DviFont *font, int code,
+					 DviGlyph *glyph));
+typedef void (*DviCacheGlyph)	__PROTO((DviContext *context,
+					 DviFont *font, int code,
+					 DviGlyph *glyph));
 
 struct _DviDevice {
 	DviGlyphDraw	draw_glyph;
@@ -114,12 +127,15 @@ struct _DviDevice {
 	DviColorScale	alloc_colors;
 	DviCreateImage	create_image;
 	DviFreeImage	free_image;
+	DviRefImage	ref_image;
 	DviPutPixel	put_pixel;
         DviImageDone    image_done;
 	DviDevDestroy	dev_destroy;
 	DviRefresh	refresh;
 	DviSetColor	set_color;
 	DviPSDraw       draw_ps;
+	DviLookupGlyph	lookup_glyph;
+	DviCacheGlyph	cache_glyph;
 	void *		device_data;
 };
 
@@ -197,6 +213,9 @@ struct _DviFontChar {
 	Ulong	fg;
 	Ulong	bg;
 	BITMAP	*glyph_data;
+	/* shrink factors `shrunk' and `grey' were made with */
+	int	hshrink;
+	int	vshrink;
 	/* data for shrunk bitimaps */
 	DviGlyph glyph;
 	DviGlyph shrunk;
@@ -398,6 +417,7 @@ struct _DviContext {
 
 	DviFontRef *(*findref) __PROTO((DviContext *, Int32));
 	void	*user_data;	/* client data attached to this context */
+	DviContext *parent;	/* context we share fonts and pages with */
 };
 
 typedef enum {
@@ -496,6 +516,7 @@ extern void mdvi_init_kpathsea __PROTO((const char *, const char *, const char *
 
 extern DviContext* mdvi_init_context __PROTO((DviParams *, DviPageSpec *, const char *));
 extern void 	mdvi_destroy_context __PROTO((DviContext *));
+extern DviContext* mdvi_clone_context __PROTO((DviContext *));
 
 /* helper macros that call mdvi_configure() */
 #define mdvi_config_one(d,x,y)	mdvi_configure((d), (x), (y), MDVI_PARAM_LAST)
@@ -594,6 +615,11 @@ extern void font_transform_glyph __PROTO((DviOrientation, DviGlyph *));
 /* destroy all fonts that are not being used, returns number of fonts freed */
 extern int font_free_unused __PROTO((DviDevice *));
 
+/* serialize access to the glyphs shared by all contexts */
+extern void mdvi_set_font_lock __PROTO((void (*)(void), void (*)(void)));
+extern void font_lock __PROTO((void));
+extern void font_unlock __PROTO((void));
+
 #define font_free_glyph(dev, font, code) \
 	font_reset_one_glyph((dev), \
 	FONTCHAR((font), (code)), MDVI_FONTSEL_GLYPH)
@@ -609,6 +635,8 @@ extern int mdvi_unregister_font_type __PROTO((const char *, int));
 extern char *mdvi_lookup_font __PROTO((DviFontSearch *));
 extern DviFont *mdvi_add_font __PROTO((const char *, Int32, int, int, Int32));
 extern int mdvi_font_retry __PROTO((DviParams *, DviFont *));
+extern int mdvi_init_font_cache __PROTO((const char *));
+extern int mdvi_save_font_cache __PROTO((void));
 
 /* Miscellaneous */
 
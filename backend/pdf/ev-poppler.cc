@@ -53,6 +53,7 @@
 #include "ev-selection.h"
 #include "ev-transition-effect.h"
 #include "ev-attachment.h"
+#include "ev-file-helpers.h"
 #include "ev-image.h"
 
 #include <libxml/tree.h>
@@ -71,6 +72,9 @@
 /* license field from Creative Commons schema, http://creativecommons.org/ns */
 #define LICENSE_URI "/x:xmpmeta/rdf:RDF/rdf:Description/cc:license/@rdf:resource"
 
+/* Larger documents are read lazily by poppler */
+#define PDF_DOCUMENT_MAX_READ_SIZE (64 * 1024 * 1024)
+
 typedef struct {
 	EvFileExporterFormat format;
 
@@ -99,6 +103,7 @@ struct _PdfDocument
 	EvDocument parent_instance;
 
 	PopplerDocument *document;
+	GBytes *data;
 	gchar *password;
 	gboolean forms_modified;
 	gboolean annots_modified;
@@ -190,6 +195,10 @@ pdf_document_dispose (GObject *object)
 		g_object_unref (pdf_document->document);
 	}
 
+	if (pdf_document->data) {
+		g_bytes_unref (pdf_document->data);
+	}
+
 	if (pdf_document->font_info) { 
 		poppler_font_info_free (pdf_document->font_info);
 	}
@@ -270,8 +279,24 @@ pdf_document_load (EvDocument   *document,
 	GError *poppler_error = NULL;
 	PdfDocument *pdf_document = PDF_DOCUMENT (document);
 
-	pdf_document->document =
-		poppler_document_new_from_file (uri, pdf_document->password, &poppler_error);
+	/* Parse files that aren't too large from memory, poppler doesn't
+	 * copy the data, it only wraps it in a memory stream. Larger ones
+	 * are read lazily from the file.
+	 */
+	if (pdf_document->data)
+		g_bytes_unref (pdf_document->data);
+	pdf_document->data = ev_file_read_bytes (uri, PDF_DOCUMENT_MAX_READ_SIZE, NULL);
+
+	if (pdf_document->data) {
+		pdf_document->document =
+			poppler_document_new_from_data ((char *)g_bytes_get_data (pdf_document->data, NULL),
+							g_bytes_get_size (pdf_document->data),
+							pdf_document->password,
+							&poppler_error);
+	} else {
+		pdf_document->document =
+			poppler_document_new_from_file (uri, pdf_document->password, &poppler_error);
+	}
 
 	if (pdf_document->document == NULL) {
 		convert_error (poppler_error, error);
@@ -25,6 +25,7 @@
 #include <libspectre/spectre.h>
 
 #include "ev-spectre.h"
+#include "ps-render-server.h"
 
 #include "ev-file-exporter.h"
 #include "ev-document-misc.h"
@@ -34,8 +35,21 @@ struct _PSDocument {
 
 	SpectreDocument *doc;
 	SpectreExporter *exporter;
+
+	gchar          *filename;
+
+	/* Ghostscript process rendering the pages, when possible */
+	GMutex          server_mutex;
+	PSRenderServer *server;
+	gboolean        server_unavailable;
+	GHashTable     *server_failed_pages;
+	gint64          server_last_used;
+	guint           server_idle_id;
 };
 
+/* Seconds a render server can stay unused before it's stopped */
+#define PS_SERVER_IDLE_TIMEOUT 60
+
 struct _PSDocumentClass {
 	EvDocumentClass parent_class;
 };
@@ -52,6 +66,8 @@ EV_BACKEND_REGISTER_WITH_CODE (PSDocument, ps_document,
 static void
 ps_document_init (PSDocument *ps_document)
 {
+	g_mutex_init (&ps_document->server_mutex);
+	ps_document->server_failed_pages = g_hash_table_new (NULL, NULL);
 }
 
 static void
@@ -69,9 +85,33 @@ ps_document_dispose (GObject *object)
 		ps->exporter = NULL;
 	}
 
+	g_mutex_lock (&ps->server_mutex);
+	if (ps->server_idle_id > 0) {
+		g_source_remove (ps->server_idle_id);
+		ps->server_idle_id = 0;
+	}
+	g_mutex_unlock (&ps->server_mutex);
+
+	if (ps->server) {
+		ps_render_server_free (ps->server);
+		ps->server = NULL;
+	}
+
 	G_OBJECT_CLASS (ps_document_parent_class)->dispose (object);
 }
 
+static void
+ps_document_finalize (GObject *object)
+{
+	PSDocument *ps = PS_DOCUMENT (object);
+
+	g_free (ps->filename);
+	g_hash_table_destroy (ps->server_failed_pages);
+	g_mutex_clear (&ps->server_mutex);
+
+	G_OBJECT_CLASS (ps_document_parent_class)->finalize (object);
+}
+
 /* EvDocumentIface */
 static gboolean
 ps_document_load (EvDocument *document,
@@ -103,7 +143,8 @@ ps_document_load (EvDocument *document,
 		return FALSE;
 	}
 
-	g_free (filename);
+	g_free (ps->filename);
+	ps->filename = filename;
 
 	return TRUE;
 }
@@ -279,10 +320,97 @@ ps_document_get_backend_info (EvDocument            *document,
 	return TRUE;
 }
 
+static void
+ps_document_weak_ref_free (GWeakRef *ps_ref)
+{
+	g_weak_ref_clear (ps_ref);
+	g_slice_free (GWeakRef, ps_ref);
+}
+
+/* The timeout is added from a render thread, so it only holds a weak
+ * reference to the document
+ */
+static gboolean
+ps_document_server_idle_cb (GWeakRef *ps_ref)
+{
+	PSDocument *ps;
+	gboolean    retval = TRUE;
+
+	ps = g_weak_ref_get (ps_ref);
+	if (!ps)
+		return FALSE;
+
+	if (!g_mutex_trylock (&ps->server_mutex)) {
+		g_object_unref (ps);
+		return TRUE;
+	}
+
+	if (g_get_monotonic_time () - ps->server_last_used >= PS_SERVER_IDLE_TIMEOUT * G_USEC_PER_SEC) {
+		ps_render_server_stop (ps->server);
+		ps->server_idle_id = 0;
+		retval = FALSE;
+	}
+	g_mutex_unlock (&ps->server_mutex);
+
+	g_object_unref (ps);
+
+	return retval;
+}
+
+/* Renders the page unrotated with a ghostscript process that keeps
+ * the document prolog loaded. Returns NULL if the document or the page
+ * can't be rendered that way.
+ */
+static cairo_surface_t *
+ps_document_render_with_server (PSDocument *ps,
+				gint        page,
+				gint        width_points,
+				gint        height_points,
+				gint        width,
+				gint        height)
+{
+	cairo_surface_t *surface = NULL;
+
+	g_mutex_lock (&ps->server_mutex);
+
+	if (!ps->server && !ps->server_unavailable) {
+		ps->server = ps_render_server_new (ps->filename,
+						   spectre_document_get_n_pages (ps->doc));
+		ps->server_unavailable = ps->server == NULL;
+	}
+
+	if (ps->server &&
+	    !g_hash_table_contains (ps->server_failed_pages, GINT_TO_POINTER (page))) {
+		surface = ps_render_server_render_page (ps->server, page,
+							width_points, height_points,
+							width, height);
+		if (!surface)
+			g_hash_table_add (ps->server_failed_pages, GINT_TO_POINTER (page));
+
+		ps->server_last_used = g_get_monotonic_time ();
+		if (ps_render_server_is_running (ps->server) && ps->server_idle_id == 0) {
+			GWeakRef *ps_ref = g_slice_new0 (GWeakRef);
+
+			g_weak_ref_init (ps_ref, ps);
+			ps->server_idle_id =
+				g_timeout_add_seconds_full (G_PRIORITY_DEFAULT,
+							    PS_SERVER_IDLE_TIMEOUT,
+							    (GSourceFunc)ps_document_server_idle_cb,
+							    ps_ref,
+							    (GDestroyNotify)ps_document_weak_ref_free);
+		}
+	}
+
+	g_mutex_unlock (&ps->server_mutex);
+
+	return surface;
+}
+
 static cairo_surface_t *
 ps_document_render (EvDocument      *document,
 		    EvRenderContext *rc)
 {
+	PSDocument           *ps = PS_DOCUMENT (document);
 	SpectrePage          *ps_page;
 	SpectreRenderContext *src;
 	gint                  width_points;
@@ -304,6 +432,20 @@ ps_document_render (EvDocument      *document,
 
 	rotation = (rc->rotation + get_page_rotation (ps_page)) % 360;
 
+	surface = ps_document_render_with_server (ps, rc->page->index,
+						  width_points, height_points,
+						  width, height);
+	if (surface) {
+		cairo_surface_t *rotated_surface;
+
+		rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
+									     width, height,
+									     rotation);
+		cairo_surface_destroy (surface);
+
+		return rotated_surface;
+	}
+
 	src = spectre_render_context_new ();
 	spectre_render_context_set_scale (src,
 					  (gdouble)width / width_points,
@@ -347,6 +489,7 @@ ps_document_class_init (PSDocumentClass *klass)
 	EvDocumentClass *ev_document_class = EV_DOCUMENT_CLASS (klass);
 
 	object_class->dispose = ps_document_dispose;
+	object_class->finalize = ps_document_finalize;
 
 	ev_document_class->load = ps_document_load;
 	ev_document_class->save = ps_document_save;
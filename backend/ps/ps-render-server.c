@@ -0,0 +1,793 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* A ghostscript process that keeps the prolog and setup of a DSC
+ * conforming document loaded, and renders its pages on demand.
+ * libspectre starts a new ghostscript instance and runs the prolog
+ * again for every page it renders, which dominates the render time of
+ * long documents made of simple pages.
+ *
+ * Ghostscript is started with the requested resolution and page size,
+ * so the prolog and setup run on the device the pages are rendered on,
+ * like they do with libspectre. A process is kept for each of the last
+ * few sizes rendered, since the view and the thumbnails render at
+ * different sizes. Every page is run inside save/restore, and written
+ * to stdout by the ppmraw device. A marker printed to stderr after the
+ * page tells when it is done. Any failure stops the process, and the
+ * caller falls back to libspectre.
+ */
+
+#include <config.h>
+
+#include "ps-render-server.h"
+
+#if defined (G_OS_UNIX) && defined (HAVE_SIGTIMEDWAIT)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+/* Milliseconds to wait for ghostscript to run a page or the prolog */
+#define PS_RENDER_SERVER_TIMEOUT 30000
+#define PS_RENDER_SERVER_DONE    "EVINCE-PAGE-DONE"
+/* Processes kept running, each for a different page size in pixels */
+#define PS_RENDER_SERVER_MAX_PROCESSES 2
+/* Only the start of DSC comments is looked at */
+#define PS_SCAN_LINE_MAX         256
+
+typedef struct {
+	gsize offset;
+	gsize length;
+} PSSection;
+
+typedef struct {
+	GPid         pid;
+	gint         stdin_fd;
+	gint         stdout_fd;
+	gint         stderr_fd;
+
+	gdouble      width_points;
+	gdouble      height_points;
+	gint         width;
+	gint         height;
+} PSRenderProcess;
+
+struct _PSRenderServer {
+	gint         fd;
+	goffset      size;
+	time_t       mtime;
+	gsize        prolog_length;
+	GArray      *pages;
+
+	/* Most recently used first */
+	GList       *processes;
+};
+
+static gboolean
+has_prefix (const gchar *line,
+	    gsize        length,
+	    const gchar *prefix)
+{
+	gsize prefix_length = strlen (prefix);
+
+	return length >= prefix_length && strncmp (line, prefix, prefix_length) == 0;
+}
+
+/* Pages are only rendered here when their origin is the one
+ * libspectre would use, i.e. the document bounding box starts at 0 0
+ */
+static gboolean
+bounding_box_at_origin (const gchar *line,
+			gsize        length)
+{
+	gchar  *box;
+	gchar  *p, *end;
+	gdouble llx, lly;
+
+	box = g_strndup (line, length);
+	p = box + strlen ("%%BoundingBox:");
+	llx = g_ascii_strtod (p, &end);
+	if (end == p) {
+		/* (atend) or garbage */
+		g_free (box);
+		return FALSE;
+	}
+	p = end;
+	lly = g_ascii_strtod (p, &end);
+	if (end == p) {
+		g_free (box);
+		return FALSE;
+	}
+	g_free (box);
+
+	return llx == 0 && lly == 0;
+}
+
+/* Handles the line starting at offset, returns FALSE once the scan
+ * is over
+ */
+static gboolean
+ps_render_server_scan_line (PSRenderServer *server,
+			    const gchar    *line,
+			    gsize           length,
+			    goffset         offset,
+			    gint           *depth,
+			    gboolean       *failed)
+{
+	PSSection *page = NULL;
+
+	if (length < 3 || line[0] != '%' || line[1] != '%')
+		return TRUE;
+
+	if (server->pages->len > 0)
+		page = &g_array_index (server->pages, PSSection, server->pages->len - 1);
+
+	/* Comments of embedded documents don't count */
+	if (has_prefix (line, length, "%%BeginDocument")) {
+		(*depth)++;
+	} else if (has_prefix (line, length, "%%EndDocument")) {
+		*depth = MAX (*depth - 1, 0);
+	} else if (*depth > 0) {
+		;
+	} else if (has_prefix (line, length, "%%Page:")) {
+		PSSection section;
+
+		if (page)
+			page->length = offset - page->offset;
+		else
+			server->prolog_length = offset;
+
+		section.offset = offset;
+		section.length = 0;
+		g_array_append_val (server->pages, section);
+	} else if (has_prefix (line, length, "%%Trailer") ||
+		   has_prefix (line, length, "%%EOF")) {
+		return FALSE;
+	} else if (has_prefix (line, length, "%%BoundingBox:") ||
+		   has_prefix (line, length, "%%PageBoundingBox:")) {
+		if (!has_prefix (line, length, "%%BoundingBox:") ||
+		    !bounding_box_at_origin (line, length)) {
+			*failed = TRUE;
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* The document is read, not mapped: it may be rewritten while it is
+ * open, and reading a truncated mapping crashes
+ */
+static gboolean
+ps_render_server_scan (PSRenderServer *server)
+{
+	gchar     buffer[65536];
+	gchar     line[PS_SCAN_LINE_MAX];
+	gsize     line_length = 0;
+	goffset   line_offset = 0;
+	goffset   offset = 0;
+	gboolean  at_line_start = TRUE;
+	gboolean  scanning = TRUE;
+	gboolean  failed = FALSE;
+	gint      depth = 0;
+	PSSection *page;
+
+	while (scanning) {
+		gssize n, i;
+
+		n = read (server->fd, buffer, sizeof (buffer));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return FALSE;
+		if (n == 0)
+			break;
+
+		for (i = 0; i < n && scanning; i++, offset++) {
+			gchar c = buffer[i];
+
+			if (c == '\n' || c == '\r') {
+				/* A \r\n pair just makes an empty line */
+				if (!at_line_start)
+					scanning = ps_render_server_scan_line (server, line, line_length,
+									       line_offset, &depth, &failed);
+				at_line_start = TRUE;
+				continue;
+			}
+
+			if (at_line_start) {
+				at_line_start = FALSE;
+				line_offset = offset;
+				line_length = 0;
+			}
+			if (line_length < sizeof (line))
+				line[line_length++] = c;
+		}
+	}
+
+	if (scanning && !at_line_start)
+		scanning = ps_render_server_scan_line (server, line, line_length,
+						       line_offset, &depth, &failed);
+	if (failed || server->pages->len == 0)
+		return FALSE;
+
+	/* The last page ends at the trailer, or at the end of the file */
+	page = &g_array_index (server->pages, PSSection, server->pages->len - 1);
+	page->length = (scanning ? offset : line_offset) - page->offset;
+
+	return TRUE;
+}
+
+/* Reads a part of the document, unless it changed since it was scanned */
+static gchar *
+ps_render_server_read (PSRenderServer *server,
+		       goffset         offset,
+		       gsize           length)
+{
+	struct stat st;
+	gchar      *data;
+	gsize       n_read = 0;
+
+	if (fstat (server->fd, &st) < 0 ||
+	    st.st_size != server->size || st.st_mtime != server->mtime)
+		return NULL;
+
+	data = g_malloc (length);
+	while (n_read < length) {
+		gssize n;
+
+		n = pread (server->fd, data + n_read, length - n_read, offset + n_read);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			g_free (data);
+			return NULL;
+		}
+		n_read += n;
+	}
+
+	return data;
+}
+
+PSRenderServer *
+ps_render_server_new (const gchar *filename,
+		      gint         n_pages)
+{
+	PSRenderServer *server;
+	struct stat     st;
+	gchar           magic[2];
+	gchar          *gs;
+
+	gs = g_find_program_in_path ("gs");
+	if (!gs)
+		return NULL;
+	g_free (gs);
+
+	server = g_slice_new0 (PSRenderServer);
+	server->pages = g_array_new (FALSE, FALSE, sizeof (PSSection));
+
+	server->fd = open (filename, O_RDONLY | O_CLOEXEC);
+	if (server->fd < 0 || fstat (server->fd, &st) < 0 ||
+	    read (server->fd, magic, 2) != 2 || strncmp (magic, "%!", 2) != 0 ||
+	    lseek (server->fd, 0, SEEK_SET) < 0) {
+		ps_render_server_free (server);
+		return NULL;
+	}
+	server->size = st.st_size;
+	server->mtime = st.st_mtime;
+
+	if (!ps_render_server_scan (server) || server->pages->len != (guint)n_pages) {
+		ps_render_server_free (server);
+		return NULL;
+	}
+
+	return server;
+}
+
+void
+ps_render_server_free (PSRenderServer *server)
+{
+	ps_render_server_stop (server);
+	if (server->fd >= 0)
+		close (server->fd);
+	g_array_free (server->pages, TRUE);
+	g_slice_free (PSRenderServer, server);
+}
+
+gboolean
+ps_render_server_is_running (PSRenderServer *server)
+{
+	return server->processes != NULL;
+}
+
+static void
+ps_render_process_free (PSRenderProcess *process)
+{
+	close (process->stdin_fd);
+	close (process->stdout_fd);
+	close (process->stderr_fd);
+
+	kill (process->pid, SIGKILL);
+	waitpid (process->pid, NULL, 0);
+	g_spawn_close_pid (process->pid);
+
+	g_slice_free (PSRenderProcess, process);
+}
+
+void
+ps_render_server_stop (PSRenderServer *server)
+{
+	g_list_free_full (server->processes, (GDestroyNotify)ps_render_process_free);
+	server->processes = NULL;
+}
+
+static void
+ps_render_server_stop_process (PSRenderServer  *server,
+			       PSRenderProcess *process)
+{
+	server->processes = g_list_remove (server->processes, process);
+	ps_render_process_free (process);
+}
+
+/* Writing to a ghostscript that exited must fail, not kill the host.
+ * SIGPIPE is sent to the writing thread, so it is blocked only here,
+ * and consumed before unblocking it if the write raised it.
+ */
+static gssize
+write_no_sigpipe (gint         fd,
+		  const gchar *data,
+		  gsize        length)
+{
+	sigset_t sigpipe_mask;
+	sigset_t old_mask;
+	gssize   n;
+	gint     saved_errno;
+
+	sigemptyset (&sigpipe_mask);
+	sigaddset (&sigpipe_mask, SIGPIPE);
+	pthread_sigmask (SIG_BLOCK, &sigpipe_mask, &old_mask);
+
+	n = write (fd, data, length);
+	saved_errno = errno;
+
+	if (n < 0 && saved_errno == EPIPE && !sigismember (&old_mask, SIGPIPE)) {
+		struct timespec zero = { 0, 0 };
+
+		while (sigtimedwait (&sigpipe_mask, NULL, &zero) < 0 && errno == EINTR)
+			;
+	}
+
+	pthread_sigmask (SIG_SETMASK, &old_mask, NULL);
+	errno = saved_errno;
+
+	return n;
+}
+
+/* Writes the given chunks to ghostscript, and reads its output until
+ * the done marker appears on stderr
+ */
+static gboolean
+ps_render_process_run (PSRenderProcess *process,
+		       const gchar    **chunks,
+		       const gsize     *lengths,
+		       gint             n_chunks,
+		       GByteArray      *output)
+{
+	GString *messages;
+	gint64   deadline;
+	gint     chunk = 0;
+	gsize    written = 0;
+	gboolean done = FALSE;
+	gboolean retval = FALSE;
+
+	messages = g_string_new (NULL);
+	deadline = g_get_monotonic_time () + PS_RENDER_SERVER_TIMEOUT * 1000;
+
+	while (!done) {
+		GPollFD fds[3];
+		gint    n_fds = 0;
+		gint    timeout;
+		gint    i;
+
+		fds[n_fds].fd = process->stdout_fd;
+		fds[n_fds++].events = G_IO_IN;
+		fds[n_fds].fd = process->stderr_fd;
+		fds[n_fds++].events = G_IO_IN;
+		if (chunk < n_chunks) {
+			fds[n_fds].fd = process->stdin_fd;
+			fds[n_fds++].events = G_IO_OUT;
+		}
+
+		timeout = (deadline - g_get_monotonic_time ()) / 1000;
+		if (timeout <= 0) {
+			g_warning ("Timeout waiting for ghostscript");
+			break;
+		}
+
+		if (g_poll (fds, n_fds, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (i = 0; i < n_fds; i++) {
+			gchar   buffer[65536];
+			gssize  n;
+
+			if (fds[i].revents == 0)
+				continue;
+
+			if (fds[i].fd == process->stdin_fd) {
+				n = write_no_sigpipe (process->stdin_fd,
+						      chunks[chunk] + written,
+						      MIN (lengths[chunk] - written, sizeof (buffer)));
+				if (n < 0 && errno != EAGAIN && errno != EINTR)
+					goto out;
+				if (n > 0)
+					written += n;
+				while (chunk < n_chunks && written == lengths[chunk]) {
+					chunk++;
+					written = 0;
+				}
+				continue;
+			}
+
+			n = read (fds[i].fd, buffer, sizeof (buffer));
+			if (n < 0 && (errno == EAGAIN || errno == EINTR))
+				continue;
+			if (n <= 0)
+				goto out;
+
+			if (fds[i].fd == process->stdout_fd) {
+				if (output)
+					g_byte_array_append (output, (guint8 *)buffer, n);
+			} else {
+				g_string_append_len (messages, buffer, n);
+				done = strstr (messages->str, PS_RENDER_SERVER_DONE) != NULL;
+			}
+		}
+	}
+
+	if (!done)
+		goto out;
+
+	if (strstr (messages->str, "Error:")) {
+		g_warning ("%s", messages->str);
+		goto out;
+	}
+
+	/* All the output was written before the marker, but part of it
+	 * may still be in the pipe
+	 */
+	while (output) {
+		GPollFD fd = { process->stdout_fd, G_IO_IN, 0 };
+		gchar   buffer[65536];
+		gssize  n;
+
+		if (g_poll (&fd, 1, 0) <= 0)
+			break;
+		n = read (process->stdout_fd, buffer, sizeof (buffer));
+		if (n <= 0)
+			break;
+		g_byte_array_append (output, (guint8 *)buffer, n);
+	}
+
+	retval = TRUE;
+out:
+	g_string_free (messages, TRUE);
+
+	return retval;
+}
+
+/* Starts ghostscript at the resolution of the page size requested,
+ * and runs the prolog and setup once for all the pages
+ */
+static PSRenderProcess *
+ps_render_server_start_process (PSRenderServer *server,
+				gdouble         width_points,
+				gdouble         height_points,
+				gint            width,
+				gint            height)
+{
+	PSRenderProcess *process;
+	gchar           *prolog;
+	const gchar     *chunks[2];
+	gsize            lengths[2];
+	GError          *error = NULL;
+	gchar            xres[G_ASCII_DTOSTR_BUF_SIZE];
+	gchar            yres[G_ASCII_DTOSTR_BUF_SIZE];
+	gchar           *size_arg;
+	gchar           *resolution_arg;
+	gboolean         spawned;
+	gchar           *argv[] = {
+		"gs", "-q", "-dSAFER", "-dNOPAUSE", "-dNOPROMPT", "-dNOPAGEPROMPT",
+		"-dMaxBitmap=10000000", "-dTextAlphaBits=4", "-dGraphicsAlphaBits=2",
+		"-sDEVICE=ppmraw", "-sOutputFile=%stdout", "-sstdout=%stderr",
+		NULL, NULL, "-", NULL
+	};
+	static const gchar done[] = "\n(" PS_RENDER_SERVER_DONE "\\n) print flush\n";
+
+	prolog = ps_render_server_read (server, 0, server->prolog_length);
+	if (!prolog)
+		return NULL;
+
+	g_ascii_formatd (xres, sizeof (xres), "%.5f", 72.0 * width / width_points);
+	g_ascii_formatd (yres, sizeof (yres), "%.5f", 72.0 * height / height_points);
+	size_arg = g_strdup_printf ("-g%dx%d", width, height);
+	resolution_arg = g_strdup_printf ("-r%sx%s", xres, yres);
+	argv[12] = size_arg;
+	argv[13] = resolution_arg;
+
+	process = g_slice_new0 (PSRenderProcess);
+	process->width_points = width_points;
+	process->height_points = height_points;
+	process->width = width;
+	process->height = height;
+
+	spawned = g_spawn_async_with_pipes (NULL, argv, NULL,
+					    G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+					    NULL, NULL, &process->pid,
+					    &process->stdin_fd, &process->stdout_fd, &process->stderr_fd,
+					    &error);
+	g_free (size_arg);
+	g_free (resolution_arg);
+	if (!spawned) {
+		g_warning ("Failed to start ghostscript: %s", error->message);
+		g_error_free (error);
+		g_free (prolog);
+		g_slice_free (PSRenderProcess, process);
+
+		return NULL;
+	}
+
+	g_unix_set_fd_nonblocking (process->stdin_fd, TRUE, NULL);
+	g_unix_set_fd_nonblocking (process->stdout_fd, TRUE, NULL);
+	g_unix_set_fd_nonblocking (process->stderr_fd, TRUE, NULL);
+
+	chunks[0] = prolog;
+	lengths[0] = server->prolog_length;
+	chunks[1] = done;
+	lengths[1] = strlen (done);
+	if (!ps_render_process_run (process, chunks, lengths, 2, NULL)) {
+		g_free (prolog);
+		ps_render_process_free (process);
+
+		return NULL;
+	}
+	g_free (prolog);
+
+	return process;
+}
+
+/* Returns the process rendering at the given size, starting it if needed */
+static PSRenderProcess *
+ps_render_server_get_process (PSRenderServer *server,
+			      gdouble         width_points,
+			      gdouble         height_points,
+			      gint            width,
+			      gint            height)
+{
+	PSRenderProcess *process;
+	GList           *l;
+
+	for (l = server->processes; l; l = g_list_next (l)) {
+		process = l->data;
+
+		if (process->width == width && process->height == height &&
+		    process->width_points == width_points &&
+		    process->height_points == height_points) {
+			server->processes = g_list_remove_link (server->processes, l);
+			server->processes = g_list_concat (l, server->processes);
+
+			return process;
+		}
+	}
+
+	process = ps_render_server_start_process (server, width_points, height_points,
+						  width, height);
+	if (!process)
+		return NULL;
+
+	server->processes = g_list_prepend (server->processes, process);
+	if (g_list_length (server->processes) > PS_RENDER_SERVER_MAX_PROCESSES) {
+		l = g_list_last (server->processes);
+		ps_render_server_stop_process (server, l->data);
+	}
+
+	return process;
+}
+
+static const guint8 *
+ppm_get_number (const guint8 *p,
+		const guint8 *end,
+		gint         *number)
+{
+	/* Skip whitespace and comments */
+	while (p < end && (g_ascii_isspace (*p) || *p == '#')) {
+		if (*p == '#') {
+			while (p < end && *p != '\n')
+				p++;
+		} else {
+			p++;
+		}
+	}
+
+	if (p == end || !g_ascii_isdigit (*p))
+		return NULL;
+
+	*number = 0;
+	while (p < end && g_ascii_isdigit (*p)) {
+		*number = *number * 10 + (*p - '0');
+		if (*number > 100000)
+			return NULL;
+		p++;
+	}
+
+	return p;
+}
+
+static cairo_surface_t *
+ps_render_server_surface_from_ppm (GByteArray *ppm)
+{
+	const guint8    *p = ppm->data;
+	const guint8    *end = ppm->data + ppm->len;
+	cairo_surface_t *surface;
+	guchar          *data;
+	gint             stride;
+	gint             width, height, maxval;
+	gint             x, y;
+
+	if (ppm->len < 2 || p[0] != 'P' || p[1] != '6')
+		return NULL;
+	p += 2;
+
+	if (!(p = ppm_get_number (p, end, &width)) ||
+	    !(p = ppm_get_number (p, end, &height)) ||
+	    !(p = ppm_get_number (p, end, &maxval)))
+		return NULL;
+
+	/* A single whitespace separates the header from the pixels */
+	if (p == end)
+		return NULL;
+	p++;
+	if (maxval != 255 || width == 0 || height == 0 ||
+	    end - p < (gssize)width * height * 3)
+		return NULL;
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, width, height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (surface);
+		return NULL;
+	}
+
+	data = cairo_image_surface_get_data (surface);
+	stride = cairo_image_surface_get_stride (surface);
+	for (y = 0; y < height; y++) {
+		guint32 *row = (guint32 *)(data + y * stride);
+
+		for (x = 0; x < width; x++, p += 3)
+			row[x] = 0xff000000 | (p[0] << 16) | (p[1] << 8) | p[2];
+	}
+	cairo_surface_mark_dirty (surface);
+
+	return surface;
+}
+
+/* Renders the page unrotated, at width x height pixels */
+cairo_surface_t *
+ps_render_server_render_page (PSRenderServer *server,
+			      gint            page,
+			      gdouble         width_points,
+			      gdouble         height_points,
+			      gint            width,
+			      gint            height)
+{
+	PSSection       *section;
+	PSRenderProcess *process;
+	GByteArray      *ppm;
+	cairo_surface_t *surface = NULL;
+	const gchar     *chunks[3];
+	gsize            lengths[3];
+	gchar           *contents;
+	static const gchar header[] = "userdict /evince_page_save save put\n";
+	static const gchar trailer[] =
+		"\nuserdict /evince_page_save get restore\n"
+		"(" PS_RENDER_SERVER_DONE "\\n) print flush\n";
+
+	g_return_val_if_fail (page >= 0 && (guint)page < server->pages->len, NULL);
+
+	section = &g_array_index (server->pages, PSSection, page);
+	contents = ps_render_server_read (server, section->offset, section->length);
+	if (!contents) {
+		ps_render_server_stop (server);
+
+		return NULL;
+	}
+
+	process = ps_render_server_get_process (server, width_points, height_points,
+						width, height);
+	if (!process) {
+		g_free (contents);
+
+		return NULL;
+	}
+
+	chunks[0] = header;
+	lengths[0] = strlen (header);
+	chunks[1] = contents;
+	lengths[1] = section->length;
+	chunks[2] = trailer;
+	lengths[2] = strlen (trailer);
+
+	ppm = g_byte_array_new ();
+	if (ps_render_process_run (process, chunks, lengths, 3, ppm))
+		surface = ps_render_server_surface_from_ppm (ppm);
+	g_byte_array_free (ppm, TRUE);
+	g_free (contents);
+
+	/* The state of ghostscript is unknown after a failure */
+	if (!surface)
+		ps_render_server_stop_process (server, process);
+
+	return surface;
+}
+
+#else /* !G_OS_UNIX || !HAVE_SIGTIMEDWAIT */
+
+PSRenderServer *
+ps_render_server_new (const gchar *filename,
+		      gint         n_pages)
+{
+	return NULL;
+}
+
+void
+ps_render_server_free (PSRenderServer *server)
+{
+}
+
+cairo_surface_t *
+ps_render_server_render_page (PSRenderServer *server,
+			      gint            page,
+			      gdouble         width_points,
+			      gdouble         height_points,
+			      gint            width,
+			      gint            height)
+{
+	return NULL;
+}
+
+gboolean
+ps_render_server_is_running (PSRenderServer *server)
+{
+	return FALSE;
+}
+
+void
+ps_render_server_stop (PSRenderServer *server)
+{
+}
+
+#endif /* G_OS_UNIX && HAVE_SIGTIMEDWAIT */
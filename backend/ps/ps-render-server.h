@@ -0,0 +1,42 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef PS_RENDER_SERVER_H
+#define PS_RENDER_SERVER_H
+
+#include <glib.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+typedef struct _PSRenderServer PSRenderServer;
+
+PSRenderServer  *ps_render_server_new         (const gchar    *filename,
+					       gint            n_pages);
+void             ps_render_server_free        (PSRenderServer *server);
+cairo_surface_t *ps_render_server_render_page (PSRenderServer *server,
+					       gint            page,
+					       gdouble         width_points,
+					       gdouble         height_points,
+					       gint            width,
+					       gint            height);
+gboolean         ps_render_server_is_running  (PSRenderServer *server);
+void             ps_render_server_stop        (PSRenderServer *server);
+
+G_END_DECLS
+
+#endif /* PS_RENDER_SERVER_H */
@@ -24,6 +24,7 @@
 
 #include <config.h>
 #include <stdio.h>
+#include <string.h>
 #include <glib.h>
 #include <glib/gi18n-lib.h>
 
@@ -34,6 +35,9 @@
 #include "ev-file-exporter.h"
 #include "ev-file-helpers.h"
 
+/* Larger documents are read from the file by libtiff */
+#define TIFF_DOCUMENT_MAX_READ_SIZE (64 * 1024 * 1024)
+
 struct _TiffDocumentClass
 {
   EvDocumentClass parent_class;
@@ -77,6 +81,135 @@ pop_handlers (void)
 	TIFFSetWarningHandler (orig_warning_handler);
 }
 
+/* TIFF client procs reading from a copy of the file in memory */
+typedef struct {
+	GBytes *data;
+	toff_t  offset;
+} TiffBuffer;
+
+static tsize_t
+tiff_buffer_read (thandle_t handle,
+		  tdata_t   buf,
+		  tsize_t   size)
+{
+	TiffBuffer   *buffer = (TiffBuffer *)handle;
+	const guchar *data;
+	gsize         length;
+
+	data = g_bytes_get_data (buffer->data, &length);
+	if (buffer->offset >= length)
+		return 0;
+
+	size = MIN ((toff_t)size, length - buffer->offset);
+	memcpy (buf, data + buffer->offset, size);
+	buffer->offset += size;
+
+	return size;
+}
+
+static tsize_t
+tiff_buffer_write (thandle_t handle,
+		   tdata_t   buf,
+		   tsize_t   size)
+{
+	return -1;
+}
+
+static toff_t
+tiff_buffer_seek (thandle_t handle,
+		  toff_t    offset,
+		  int       whence)
+{
+	TiffBuffer *buffer = (TiffBuffer *)handle;
+
+	switch (whence) {
+	case SEEK_SET:
+		buffer->offset = offset;
+		break;
+	case SEEK_CUR:
+		buffer->offset += offset;
+		break;
+	case SEEK_END:
+		buffer->offset = g_bytes_get_size (buffer->data) + offset;
+		break;
+	default:
+		return -1;
+	}
+
+	return buffer->offset;
+}
+
+static int
+tiff_buffer_close (thandle_t handle)
+{
+	TiffBuffer *buffer = (TiffBuffer *)handle;
+
+	g_bytes_unref (buffer->data);
+	g_slice_free (TiffBuffer, buffer);
+
+	return 0;
+}
+
+static toff_t
+tiff_buffer_size (thandle_t handle)
+{
+	TiffBuffer *buffer = (TiffBuffer *)handle;
+
+	return g_bytes_get_size (buffer->data);
+}
+
+static int
+tiff_buffer_map (thandle_t handle,
+		 tdata_t  *base,
+		 toff_t   *size)
+{
+	TiffBuffer *buffer = (TiffBuffer *)handle;
+	gsize       length;
+
+	/* Let libtiff decode the strips and tiles straight from memory */
+	*base = (tdata_t)g_bytes_get_data (buffer->data, &length);
+	*size = length;
+
+	return 1;
+}
+
+static void
+tiff_buffer_unmap (thandle_t handle,
+		   tdata_t   base,
+		   toff_t    size)
+{
+}
+
+static TIFF *
+tiff_open_buffer (const char  *uri,
+		  const gchar *filename)
+{
+	TiffBuffer *buffer;
+	GBytes     *data;
+	TIFF       *tiff;
+
+	data = ev_file_read_bytes (uri, TIFF_DOCUMENT_MAX_READ_SIZE, NULL);
+	if (!data)
+		return NULL;
+
+	buffer = g_slice_new0 (TiffBuffer);
+	buffer->data = data;
+
+	tiff = TIFFClientOpen (filename, "r",
+			       (thandle_t)buffer,
+			       tiff_buffer_read,
+			       tiff_buffer_write,
+			       tiff_buffer_seek,
+			       tiff_buffer_close,
+			       tiff_buffer_size,
+			       tiff_buffer_map,
+			       tiff_buffer_unmap);
+	if (!tiff)
+		tiff_buffer_close ((thandle_t)buffer);
+
+	return tiff;
+}
+
 static gboolean
 tiff_document_load (EvDocument  *document,
 		    const char  *uri,
@@ -92,20 +225,21 @@ tiff_document_load (EvDocument  *document,
 	
 	push_handlers ();
 
+	tiff = tiff_open_buffer (uri, filename);
+	if (!tiff) {
 #ifdef G_OS_WIN32
-{
-	wchar_t *wfilename = g_utf8_to_utf16 (filename, -1, NULL, NULL, error);
-	if (wfilename == NULL) {
-		return FALSE;
-	}
+		wchar_t *wfilename = g_utf8_to_utf16 (filename, -1, NULL, NULL, error);
+		if (wfilename == NULL) {
+			return FALSE;
+		}
 
-	tiff = TIFFOpenW (wfilename, "r");
+		tiff = TIFFOpenW (wfilename, "r");
 
-	g_free (wfilename);
-}
+		g_free (wfilename);
 #else
-	tiff = TIFFOpen (filename, "r");
+		tiff = TIFFOpen (filename, "r");
 #endif
+	}
 	if (tiff) {
 		guint32 w, h;
 		
@@ -33,8 +33,24 @@ struct _XPSDocument {
 	GFile        *file;
 	GXPSFile     *xps;
 	GXPSDocument *doc;
+
+	/* Recently used pages, most recent first */
+	GMutex        pages_mutex;
+	GHashTable   *pages;
+	GQueue        pages_lru;
 };
 
+/* Maximum number of GXPSPage objects kept alive. A page keeps the
+ * images it decoded, so they are not decoded again when the page is
+ * rendered at another scale, or printed. */
+#define XPS_PAGE_CACHE_SIZE 8
+
+typedef struct {
+	gint      index;
+	GXPSPage *page;
+	GList    *link;
+} XPSPageCacheEntry;
+
 struct _XPSDocumentClass {
 	EvDocumentClass parent_class;
 };
@@ -52,8 +68,62 @@ EV_BACKEND_REGISTER_WITH_CODE (XPSDocument, xps_document,
 
 /* XPSDocument */
 static void
-xps_document_init (XPSDocument *ps_document)
+xps_page_cache_entry_free (XPSPageCacheEntry *entry)
 {
+	g_object_unref (entry->page);
+	g_slice_free (XPSPageCacheEntry, entry);
+}
+
+static void
+xps_document_init (XPSDocument *xps_document)
+{
+	g_mutex_init (&xps_document->pages_mutex);
+	xps_document->pages = g_hash_table_new_full (NULL, NULL, NULL,
+						     (GDestroyNotify)xps_page_cache_entry_free);
+	g_queue_init (&xps_document->pages_lru);
+}
+
+/* Returns a new reference to the page, parsing it only if it's not cached */
+static GXPSPage *
+xps_document_get_gxps_page (XPSDocument *xps,
+			    gint         index)
+{
+	XPSPageCacheEntry *entry;
+	GXPSPage          *xps_page;
+
+	g_mutex_lock (&xps->pages_mutex);
+
+	entry = g_hash_table_lookup (xps->pages, GINT_TO_POINTER (index));
+	if (entry) {
+		g_queue_unlink (&xps->pages_lru, entry->link);
+		g_queue_push_head_link (&xps->pages_lru, entry->link);
+	} else {
+		xps_page = gxps_document_get_page (xps->doc, index, NULL);
+		if (!xps_page) {
+			g_mutex_unlock (&xps->pages_mutex);
+			return NULL;
+		}
+
+		entry = g_slice_new (XPSPageCacheEntry);
+		entry->index = index;
+		entry->page = xps_page;
+		g_queue_push_head (&xps->pages_lru, entry);
+		entry->link = xps->pages_lru.head;
+		g_hash_table_insert (xps->pages, GINT_TO_POINTER (index), entry);
+
+		if (xps->pages_lru.length > XPS_PAGE_CACHE_SIZE) {
+			XPSPageCacheEntry *last;
+
+			last = g_queue_pop_tail (&xps->pages_lru);
+			g_hash_table_remove (xps->pages, GINT_TO_POINTER (last->index));
+		}
+	}
+
+	xps_page = g_object_ref (entry->page);
+
+	g_mutex_unlock (&xps->pages_mutex);
+
+	return xps_page;
 }
 
 static void
@@ -71,6 +141,12 @@ xps_document_dispose (GObject *object)
 		xps->xps = NULL;
 	}
 
+	if (xps->pages) {
+		g_hash_table_destroy (xps->pages);
+		xps->pages = NULL;
+		g_queue_clear (&xps->pages_lru);
+	}
+
 	if (xps->doc) {
 		g_object_unref (xps->doc);
 		xps->doc = NULL;
@@ -79,6 +155,16 @@ xps_document_dispose (GObject *object)
 	G_OBJECT_CLASS (xps_document_parent_class)->dispose (object);
 }
 
+static void
+xps_document_finalize (GObject *object)
+{
+	XPSDocument *xps = XPS_DOCUMENT (object);
+
+	g_mutex_clear (&xps->pages_mutex);
+
+	G_OBJECT_CLASS (xps_document_parent_class)->finalize (object);
+}
+
 /* EvDocumentIface */
 static gboolean
 xps_document_load (EvDocument *document,
@@ -140,7 +226,7 @@ xps_document_get_page (EvDocument *document,
 	GXPSPage    *xps_page;
 	EvPage      *page;
 
-	xps_page = gxps_document_get_page (xps->doc, index, NULL);
+	xps_page = xps_document_get_gxps_page (xps, index);
 	page = ev_page_new (index);
 	if (xps_page) {
 		page->backend_page = (EvBackendPage)xps_page;
@@ -175,9 +261,11 @@ xps_document_get_info (EvDocument *document)
 	if (info->n_pages > 0) {
                 GXPSPage *gxps_page;
 
-                gxps_page = gxps_document_get_page (xps->doc, 0, NULL);
-		gxps_page_get_size (gxps_page, &(info->paper_width), &(info->paper_height));
-                g_object_unref (gxps_page);
+                gxps_page = xps_document_get_gxps_page (xps, 0);
+		if (gxps_page) {
+			gxps_page_get_size (gxps_page, &(info->paper_width), &(info->paper_height));
+			g_object_unref (gxps_page);
+		}
 
 		info->paper_width  = info->paper_width / 96.0f * 25.4f;
 		info->paper_height = info->paper_height / 96.0f * 25.4f;
@@ -259,6 +347,7 @@ xps_document_class_init (XPSDocumentClass *klass)
 	EvDocumentClass *ev_document_class = EV_DOCUMENT_CLASS (klass);
 
 	object_class->dispose = xps_document_dispose;
+	object_class->finalize = xps_document_finalize;
 
 	ev_document_class->load = xps_document_load;
 	ev_document_class->save = xps_document_save;
@@ -457,7 +546,7 @@ xps_document_links_find_link_dest (EvDocumentLinks *document_links,
 	if (page == -1)
 		return NULL;
 
-	xps_page = gxps_document_get_page (xps_document->doc, page, NULL);
+	xps_page = xps_document_get_gxps_page (xps_document, page);
 	if (!xps_page)
 		return NULL;
 
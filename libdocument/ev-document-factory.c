@@ -284,6 +284,27 @@ _ev_document_factory_shutdown (void)
  */
 EvDocument *
 ev_document_factory_get_document (const char *uri, GError **error)
+{
+	return ev_document_factory_get_document_full (uri, EV_DOCUMENT_LOAD_FLAG_NONE, error);
+}
+
+/**
+ * ev_document_factory_get_document_full:
+ * @uri: an URI
+ * @flags: flags from #EvDocumentLoadFlags
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Creates a #EvDocument for the document at @uri like
+ * ev_document_factory_get_document(), loading it with @flags.
+ *
+ * Returns: (transfer full): a new #EvDocument, or %NULL
+ *
+ * Since: 3.14
+ */
+EvDocument *
+ev_document_factory_get_document_full (const char         *uri,
+				       EvDocumentLoadFlags flags,
+				       GError            **error)
 {
 	EvDocument *document;
 	int result;
@@ -310,7 +331,7 @@ ev_document_factory_get_document (const char *uri, GError **error)
 			return NULL;
 		}
 
-		result = ev_document_load (document, uri_unc ? uri_unc : uri, &err);
+		result = ev_document_load_full (document, uri_unc ? uri_unc : uri, flags, &err);
 
 		if (result == FALSE || err) {
 			if (err &&
@@ -352,7 +373,7 @@ ev_document_factory_get_document (const char *uri, GError **error)
 		return NULL;
 	}
 
-	result = ev_document_load (document, uri_unc ? uri_unc : uri, &err);
+	result = ev_document_load_full (document, uri_unc ? uri_unc : uri, flags, &err);
 	if (result == FALSE) {
 		if (err == NULL) {
 			/* FIXME: this really should not happen; the backend should
@@ -39,9 +39,13 @@ typedef struct _EvPageSize
 struct _EvDocumentPrivate
 {
 	gchar          *uri;
+	gchar          *cache_key;
 
 	gint            n_pages;
 
+	/* Set under the doc mutex once the page sizes are cached */
+	gboolean        cache_loaded;
+
 	gboolean        uniform;
 	gdouble         uniform_width;
 	gdouble         uniform_height;
@@ -57,6 +61,8 @@ struct _EvDocumentPrivate
 	EvDocumentInfo *info;
 
 	synctex_scanner_t synctex_scanner;
+	GThread          *synctex_thread;
+	GMutex            synctex_mutex;
 };
 
 static gint            _ev_document_get_n_pages     (EvDocument *document);
@@ -69,6 +75,13 @@ static gchar          *_ev_document_get_page_label  (EvDocument *document,
 static EvDocumentInfo *_ev_document_get_info        (EvDocument *document);
 static gboolean        _ev_document_support_synctex (EvDocument *document);
 
+enum {
+	PAGE_SIZE_CHANGED,
+	N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
 static GMutex ev_doc_mutex;
 static GMutex ev_fc_mutex;
 
@@ -107,6 +120,9 @@ ev_document_finalize (GObject *object)
 		document->priv->uri = NULL;
 	}
 
+	g_free (document->priv->cache_key);
+	document->priv->cache_key = NULL;
+
 	if (document->priv->page_sizes) {
 		g_free (document->priv->page_sizes);
 		document->priv->page_sizes = NULL;
@@ -127,10 +143,16 @@ ev_document_finalize (GObject *object)
 		document->priv->info = NULL;
 	}
 
+	if (document->priv->synctex_thread) {
+		document->priv->synctex_scanner = g_thread_join (document->priv->synctex_thread);
+		document->priv->synctex_thread = NULL;
+	}
+
 	if (document->priv->synctex_scanner) {
 		synctex_scanner_free (document->priv->synctex_scanner);
 		document->priv->synctex_scanner = NULL;
 	}
+	g_mutex_clear (&document->priv->synctex_mutex);
 
 	G_OBJECT_CLASS (ev_document_parent_class)->finalize (object);
 }
@@ -142,6 +164,7 @@ ev_document_init (EvDocument *document)
 
 	/* Assume all pages are the same size until proven otherwise */
 	document->priv->uniform = TRUE;
+	g_mutex_init (&document->priv->synctex_mutex);
 }
 
 static void
@@ -156,6 +179,26 @@ ev_document_class_init (EvDocumentClass *klass)
 	klass->get_backend_info = NULL;
 
 	g_object_class->finalize = ev_document_finalize;
+
+	/**
+	 * EvDocument::page-size-changed:
+	 * @document: the #EvDocument
+	 * @page: the index of the page
+	 *
+	 * Emitted when the backend updates the size of @page after the
+	 * document has been loaded, see ev_document_set_page_size().
+	 *
+	 * Since: 3.14
+	 */
+	signals[PAGE_SIZE_CHANGED] =
+		g_signal_new ("page-size-changed",
+			      EV_TYPE_DOCUMENT,
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__INT,
+			      G_TYPE_NONE, 1,
+			      G_TYPE_INT);
 }
 
 void
@@ -195,18 +238,30 @@ ev_document_fc_mutex_trylock (void)
 }
 
 static void
-ev_document_setup_cache (EvDocument *document)
+ev_document_setup_cache (EvDocument         *document,
+                         EvDocumentLoadFlags flags)
 {
         EvDocumentPrivate *priv = document->priv;
+        gint n_cached_pages;
         gint i;
 
+        ev_document_doc_mutex_lock ();
+        priv->cache_loaded = FALSE;
+        ev_document_doc_mutex_unlock ();
+
         /* Cache some info about the document to avoid
          * going to the backends since it requires locks
          */
 	priv->info = _ev_document_get_info (document);
         priv->n_pages = _ev_document_get_n_pages (document);
 
-        for (i = 0; i < priv->n_pages; i++) {
+        /* Without cache all pages are assumed to have
+         * the size of the first one
+         */
+        n_cached_pages = (flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE) ?
+                MIN (priv->n_pages, 1) : priv->n_pages;
+
+        for (i = 0; i < n_cached_pages; i++) {
                 EvPage     *page = ev_document_get_page (document, i);
                 gdouble     page_width = 0;
                 gdouble     page_height = 0;
@@ -254,6 +309,11 @@ ev_document_setup_cache (EvDocument *document)
                                 priv->min_height = page_height;
                 }
 
+                if (flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE) {
+                        g_object_unref (page);
+                        continue;
+                }
+
                 page_label = _ev_document_get_page_label (document, page);
                 if (page_label) {
                         if (!priv->page_labels)
@@ -266,6 +326,17 @@ ev_document_setup_cache (EvDocument *document)
 
                 g_object_unref (page);
         }
+
+        ev_document_doc_mutex_lock ();
+        priv->cache_loaded = TRUE;
+        ev_document_doc_mutex_unlock ();
+}
+
+static gpointer
+ev_document_synctex_parse_thread (gpointer data)
+{
+	/* synctex_scanner_parse() frees the scanner and returns NULL on error */
+	return synctex_scanner_parse ((synctex_scanner_t) data);
 }
 
 static void
@@ -273,17 +344,47 @@ ev_document_initialize_synctex (EvDocument  *document,
 				const gchar *uri)
 {
 	EvDocumentPrivate *priv = document->priv;
+	synctex_scanner_t  scanner;
+	gchar             *filename;
 
-	if (_ev_document_support_synctex (document)) {
-		gchar *filename;
+	if (!_ev_document_support_synctex (document))
+		return;
 
-		filename = g_filename_from_uri (uri, NULL, NULL);
-		if (filename != NULL) {
-			priv->synctex_scanner =
-				synctex_scanner_new_with_output_file (filename, NULL, 1);
-			g_free (filename);
-		}
+	filename = g_filename_from_uri (uri, NULL, NULL);
+	if (filename == NULL)
+		return;
+
+	/* Only locate and open the synctex file here. Parsing the whole
+	 * file can take seconds for large documents, so it's done in a
+	 * separate thread and the first search waits for it if needed.
+	 */
+	scanner = synctex_scanner_new_with_output_file (filename, NULL, 0);
+	g_free (filename);
+	if (scanner == NULL)
+		return;
+
+	priv->synctex_thread = g_thread_try_new ("EvSynctexParser",
+						 ev_document_synctex_parse_thread,
+						 scanner, NULL);
+	if (priv->synctex_thread == NULL)
+		priv->synctex_scanner = synctex_scanner_parse (scanner);
+}
+
+static synctex_scanner_t
+ev_document_get_synctex_scanner (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+	synctex_scanner_t  scanner;
+
+	g_mutex_lock (&priv->synctex_mutex);
+	if (priv->synctex_thread) {
+		priv->synctex_scanner = g_thread_join (priv->synctex_thread);
+		priv->synctex_thread = NULL;
 	}
+	scanner = priv->synctex_scanner;
+	g_mutex_unlock (&priv->synctex_mutex);
+
+	return scanner;
 }
 
 /**
@@ -307,6 +408,28 @@ gboolean
 ev_document_load (EvDocument  *document,
 		  const char  *uri,
 		  GError     **error)
+{
+	return ev_document_load_full (document, uri, EV_DOCUMENT_LOAD_FLAG_NONE, error);
+}
+
+/**
+ * ev_document_load_full:
+ * @document: a #EvDocument
+ * @uri: the document's URI
+ * @flags: flags from #EvDocumentLoadFlags
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Loads @document from @uri like ev_document_load(), with @flags.
+ *
+ * Returns: %TRUE on success, or %FALSE on failure.
+ *
+ * Since: 3.14
+ */
+gboolean
+ev_document_load_full (EvDocument         *document,
+		       const char         *uri,
+		       EvDocumentLoadFlags flags,
+		       GError            **error)
 {
 	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
 	gboolean retval;
@@ -327,9 +450,10 @@ ev_document_load (EvDocument  *document,
 					     "Internal error in backend");
 		}
 	} else {
-                ev_document_setup_cache (document);
+                ev_document_setup_cache (document, flags);
 		document->priv->uri = g_strdup (uri);
-		ev_document_initialize_synctex (document, uri);
+		if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
+			ev_document_initialize_synctex (document, uri);
         }
 
 	return retval;
@@ -374,7 +498,7 @@ ev_document_load_stream (EvDocument         *document,
         if (!klass->load_stream (document, stream, flags, cancellable, error))
                 return FALSE;
 
-        ev_document_setup_cache (document);
+        ev_document_setup_cache (document, flags);
 
         return TRUE;
 }
@@ -418,9 +542,10 @@ ev_document_load_gfile (EvDocument         *document,
         if (!klass->load_gfile (document, file, flags, cancellable, error))
                 return FALSE;
 
-        ev_document_setup_cache (document);
+        ev_document_setup_cache (document, flags);
 	document->priv->uri = g_file_get_uri (file);
-	ev_document_initialize_synctex (document, document->priv->uri);
+	if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
+		ev_document_initialize_synctex (document, document->priv->uri);
 
         return TRUE;
 }
@@ -472,9 +597,19 @@ _ev_document_support_synctex (EvDocument *document)
 gboolean
 ev_document_has_synctex (EvDocument *document)
 {
+	gboolean has_synctex;
+
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
 
-	return document->priv->synctex_scanner != NULL;
+	/* Don't wait for the scanner to be parsed, a document with a synctex
+	 * file that is still being parsed is considered to have synctex.
+	 */
+	g_mutex_lock (&document->priv->synctex_mutex);
+	has_synctex = document->priv->synctex_thread != NULL ||
+		document->priv->synctex_scanner != NULL;
+	g_mutex_unlock (&document->priv->synctex_mutex);
+
+	return has_synctex;
 }
 
 /**
@@ -503,7 +638,7 @@ ev_document_synctex_backward_search (EvDocument *document,
 
         g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
 
-        scanner = document->priv->synctex_scanner;
+        scanner = ev_document_get_synctex_scanner (document);
         if (!scanner)
                 return NULL;
 
@@ -548,7 +683,7 @@ ev_document_synctex_forward_search (EvDocument   *document,
 
         g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
 
-        scanner = document->priv->synctex_scanner;
+        scanner = ev_document_get_synctex_scanner (document);
         if (!scanner)
                 return NULL;
 
@@ -688,6 +823,79 @@ ev_document_render (EvDocument      *document,
 	return klass->render (document, rc);
 }
 
+/**
+ * ev_document_can_render_region:
+ * @document: an #EvDocument
+ *
+ * Returns: %TRUE if the backend of @document can render a region of a
+ *   page without rendering the whole page
+ *
+ * Since: 3.14
+ */
+gboolean
+ev_document_can_render_region (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	return EV_DOCUMENT_GET_CLASS (document)->render_region != NULL;
+}
+
+static cairo_surface_t *
+_ev_document_render_region (EvDocument            *document,
+			    EvRenderContext       *rc,
+			    cairo_rectangle_int_t *region)
+{
+	cairo_surface_t *surface;
+	cairo_surface_t *region_surface;
+	cairo_t         *cr;
+
+	surface = ev_document_render (document, rc);
+	if (!surface)
+		return NULL;
+
+	region_surface = cairo_image_surface_create (cairo_image_surface_get_format (surface),
+						     region->width, region->height);
+	cr = cairo_create (region_surface);
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface (cr, surface, -region->x, -region->y);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+	cairo_surface_destroy (surface);
+
+	return region_surface;
+}
+
+/**
+ * ev_document_render_region:
+ * @document: an #EvDocument
+ * @rc: an #EvRenderContext
+ * @region: the area of the page to render, in pixels of the page rendered
+ *   with @rc, that is, after scaling and rotating it
+ *
+ * Renders only @region of the page. Backends that can't do it, see
+ * ev_document_can_render_region(), render the whole page and the region is
+ * copied from it.
+ *
+ * Returns: (transfer full): a surface of the size of @region
+ *
+ * Since: 3.14
+ */
+cairo_surface_t *
+ev_document_render_region (EvDocument            *document,
+			   EvRenderContext       *rc,
+			   cairo_rectangle_int_t *region)
+{
+	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+
+	g_return_val_if_fail (region != NULL, NULL);
+	g_return_val_if_fail (region->width > 0 && region->height > 0, NULL);
+
+	if (klass->render_region)
+		return klass->render_region (document, rc, region);
+
+	return _ev_document_render_region (document, rc, region);
+}
+
 static GdkPixbuf *
 _ev_document_get_thumbnail (EvDocument      *document,
 			    EvRenderContext *rc)
@@ -751,6 +959,75 @@ ev_document_get_uri (EvDocument *document)
 	return document->priv->uri;
 }
 
+/**
+ * ev_document_set_uri:
+ * @document: an #EvDocument
+ * @uri: the URI of a local file with the contents of @document
+ *
+ * Sets the URI of a document loaded with ev_document_load_stream(), once
+ * the whole stream has been written to the file at @uri, so that the data
+ * cached on disk for files can be used for the document too. It has no
+ * effect on documents that already have a URI.
+ *
+ * Since: 3.14
+ */
+void
+ev_document_set_uri (EvDocument  *document,
+		     const gchar *uri)
+{
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+	g_return_if_fail (uri != NULL);
+
+	if (document->priv->uri)
+		return;
+
+	document->priv->uri = g_strdup (uri);
+}
+
+/**
+ * ev_document_get_cache_key:
+ * @document: an #EvDocument
+ *
+ * Returns: the key the data cached on disk for @document is stored
+ *   under, as set by ev_document_set_cache_key(), or %NULL if nothing
+ *   should be cached for @document
+ *
+ * Since: 3.14
+ */
+const gchar *
+ev_document_get_cache_key (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+
+	return document->priv->cache_key;
+}
+
+/**
+ * ev_document_set_cache_key:
+ * @document: an #EvDocument
+ * @cache_key: (allow-none): a key returned by ev_file_get_cache_key()
+ *
+ * Sets the key for the data cached on disk for @document. It must be
+ * computed from the same file contents @document was loaded from, so
+ * it's meant to be set by whoever loads the document, and only for
+ * documents whose contents may be written to disk, i.e. not for those
+ * that needed a password. It has no effect if @document already has
+ * a key.
+ *
+ * Since: 3.14
+ */
+void
+ev_document_set_cache_key (EvDocument  *document,
+			   const gchar *cache_key)
+{
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	if (document->priv->cache_key || !cache_key)
+		return;
+
+	document->priv->cache_key = g_strdup (cache_key);
+}
+
 const gchar *
 ev_document_get_title (EvDocument *document)
 {
@@ -760,6 +1037,101 @@ ev_document_get_title (EvDocument *document)
 		document->priv->info->title : NULL;
 }
 
+/**
+ * ev_document_set_page_size:
+ * @document: an #EvDocument
+ * @page_index: the index of the page
+ * @width: the new width of the page
+ * @height: the new height of the page
+ *
+ * Updates the size of @page_index once the document has been loaded and
+ * emits #EvDocument::page-size-changed. This is meant for backends that
+ * report provisional page sizes while loading, so that loading doesn't
+ * have to wait for every page to be parsed.
+ *
+ * The cached sizes are read by jobs holding the doc mutex, so they are
+ * replaced under it. It must be called from the main thread, without
+ * holding the doc mutex.
+ *
+ * Returns: %FALSE if the page sizes of @document haven't been cached yet,
+ *   in which case the caller should try again later, or %TRUE otherwise
+ *
+ * Since: 3.14
+ */
+gboolean
+ev_document_set_page_size (EvDocument *document,
+			   gint        page_index,
+			   gdouble     width,
+			   gdouble     height)
+{
+	EvDocumentPrivate *priv;
+	EvPageSize        *page_sizes = NULL;
+	gdouble            max_width, max_height;
+	gdouble            min_width, min_height;
+	gint               i;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), TRUE);
+
+	priv = document->priv;
+
+	ev_document_doc_mutex_lock ();
+
+	if (!priv->cache_loaded) {
+		ev_document_doc_mutex_unlock ();
+		return FALSE;
+	}
+
+	if (page_index < 0 || page_index >= priv->n_pages) {
+		ev_document_doc_mutex_unlock ();
+		g_return_val_if_reached (TRUE);
+	}
+
+	if (priv->uniform ?
+	    (priv->uniform_width == width && priv->uniform_height == height) :
+	    (priv->page_sizes[page_index].width == width &&
+	     priv->page_sizes[page_index].height == height)) {
+		ev_document_doc_mutex_unlock ();
+		return TRUE;
+	}
+
+	/* A uniform document becomes non-uniform, the table is filled
+	 * before it's published */
+	if (priv->uniform) {
+		page_sizes = g_new0 (EvPageSize, priv->n_pages);
+		for (i = 0; i < priv->n_pages; i++) {
+			page_sizes[i].width = priv->uniform_width;
+			page_sizes[i].height = priv->uniform_height;
+		}
+	} else {
+		page_sizes = priv->page_sizes;
+	}
+
+	page_sizes[page_index].width = width;
+	page_sizes[page_index].height = height;
+
+	max_width = min_width = width;
+	max_height = min_height = height;
+	for (i = 0; i < priv->n_pages; i++) {
+		max_width = MAX (max_width, page_sizes[i].width);
+		min_width = MIN (min_width, page_sizes[i].width);
+		max_height = MAX (max_height, page_sizes[i].height);
+		min_height = MIN (min_height, page_sizes[i].height);
+	}
+
+	priv->page_sizes = page_sizes;
+	priv->uniform = FALSE;
+	priv->max_width = max_width;
+	priv->max_height = max_height;
+	priv->min_width = min_width;
+	priv->min_height = min_height;
+
+	ev_document_doc_mutex_unlock ();
+
+	g_signal_emit (document, signals[PAGE_SIZE_CHANGED], 0, page_index);
+
+	return TRUE;
+}
+
 gboolean
 ev_document_is_page_size_uniform (EvDocument *document)
 {
@@ -54,8 +54,17 @@ typedef struct _EvDocumentPrivate EvDocumentPrivate;
 #define EV_DOC_MUTEX_LOCK (ev_document_doc_mutex_lock ())
 #define EV_DOC_MUTEX_UNLOCK (ev_document_doc_mutex_unlock ())
 
+/**
+ * EvDocumentLoadFlags:
+ * @EV_DOCUMENT_LOAD_FLAG_NONE: no flags
+ * @EV_DOCUMENT_LOAD_FLAG_NO_CACHE: only cache the size of the first page
+ *   instead of the size and label of every page, and don't set up SyncTeX.
+ *   This makes loading a document faster when only the first page will be
+ *   used, e.g. to create a thumbnail. Since 3.14
+ */
 typedef enum /*< flags >*/ {
-        EV_DOCUMENT_LOAD_FLAG_NONE = 0
+        EV_DOCUMENT_LOAD_FLAG_NONE     = 0,
+        EV_DOCUMENT_LOAD_FLAG_NO_CACHE = 1 << 0
 } EvDocumentLoadFlags;
 
 typedef enum
@@ -130,6 +139,9 @@ struct _EvDocumentClass
 						     GError             **error);
 	cairo_surface_t * (* get_thumbnail_surface) (EvDocument          *document,
 						     EvRenderContext     *rc);
+	cairo_surface_t * (* render_region)         (EvDocument            *document,
+						     EvRenderContext       *rc,
+						     cairo_rectangle_int_t *region);
 };
 
 GType            ev_document_get_type             (void) G_GNUC_CONST;
@@ -153,6 +165,10 @@ gboolean         ev_document_get_backend_info     (EvDocument      *document,
 gboolean         ev_document_load                 (EvDocument      *document,
 						   const char      *uri,
 						   GError         **error);
+gboolean         ev_document_load_full            (EvDocument      *document,
+						   const char      *uri,
+						   EvDocumentLoadFlags flags,
+						   GError         **error);
 gboolean         ev_document_load_stream          (EvDocument         *document,
                                                    GInputStream       *stream,
                                                    EvDocumentLoadFlags flags,
@@ -173,15 +189,28 @@ void             ev_document_get_page_size        (EvDocument      *document,
 						   gint             page_index,
 						   double          *width,
 						   double          *height);
+gboolean         ev_document_set_page_size        (EvDocument      *document,
+						   gint             page_index,
+						   gdouble          width,
+						   gdouble          height);
 gchar           *ev_document_get_page_label       (EvDocument      *document,
 						   gint             page_index);
 cairo_surface_t *ev_document_render               (EvDocument      *document,
 						   EvRenderContext *rc);
+gboolean         ev_document_can_render_region    (EvDocument      *document);
+cairo_surface_t *ev_document_render_region        (EvDocument            *document,
+						   EvRenderContext       *rc,
+						   cairo_rectangle_int_t *region);
 GdkPixbuf       *ev_document_get_thumbnail        (EvDocument      *document,
 						   EvRenderContext *rc);
 cairo_surface_t *ev_document_get_thumbnail_surface (EvDocument      *document,
 						    EvRenderContext *rc);
 const gchar     *ev_document_get_uri              (EvDocument      *document);
+void             ev_document_set_uri              (EvDocument      *document,
+						   const gchar     *uri);
+const gchar     *ev_document_get_cache_key        (EvDocument      *document);
+void             ev_document_set_cache_key        (EvDocument      *document,
+						   const gchar     *cache_key);
 const gchar     *ev_document_get_title            (EvDocument      *document);
 gboolean         ev_document_is_page_size_uniform (EvDocument      *document);
 void             ev_document_get_max_page_size    (EvDocument      *document,
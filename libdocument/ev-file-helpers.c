@@ -576,6 +576,201 @@ ev_file_get_mime_type (const gchar *uri,
 	return fast ? get_mime_type_from_uri (uri, error) : get_mime_type_from_data (uri, error);
 }
 
+#define CACHE_KEY_SAMPLE_SIZE (64 * 1024)
+
+static void
+cache_key_add_sample (GChecksum    *checksum,
+		      GInputStream *stream,
+		      guchar       *buffer)
+{
+	gssize n_read;
+
+	n_read = g_input_stream_read (stream, buffer, CACHE_KEY_SAMPLE_SIZE, NULL, NULL);
+	if (n_read > 0)
+		g_checksum_update (checksum, buffer, n_read);
+}
+
+/**
+ * ev_file_get_cache_key:
+ * @uri: a file URI
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Computes a key identifying the current contents of the file at @uri,
+ * to be used to name the data cached for it on disk. The key depends on
+ * the file identity, size and modification time, and on the first and
+ * last bytes of the file, so it changes whenever the file is modified,
+ * even if its size doesn't.
+ *
+ * Returns: a newly allocated string, or %NULL on error
+ *
+ * Since: 3.14
+ */
+gchar *
+ev_file_get_cache_key (const gchar *uri,
+		       GError     **error)
+{
+	GFile            *file;
+	GFileInfo        *info;
+	GFileInputStream *stream;
+	GChecksum        *checksum;
+	guchar           *buffer;
+	guint64           value;
+	guint64           size;
+	gchar            *key;
+
+	g_return_val_if_fail (uri != NULL, NULL);
+
+	file = g_file_new_for_uri (uri);
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+				  G_FILE_ATTRIBUTE_UNIX_DEVICE ","
+				  G_FILE_ATTRIBUTE_UNIX_INODE,
+				  G_FILE_QUERY_INFO_NONE, NULL, error);
+	if (!info) {
+		g_object_unref (file);
+		return NULL;
+	}
+
+	stream = g_file_read (file, NULL, error);
+	g_object_unref (file);
+	if (!stream) {
+		g_object_unref (info);
+		return NULL;
+	}
+
+	checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+	size = g_file_info_get_size (info);
+	g_checksum_update (checksum, (const guchar *)&size, sizeof (size));
+	value = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	g_checksum_update (checksum, (const guchar *)&value, sizeof (value));
+	value = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	g_checksum_update (checksum, (const guchar *)&value, sizeof (value));
+	value = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+	g_checksum_update (checksum, (const guchar *)&value, sizeof (value));
+	value = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+	g_checksum_update (checksum, (const guchar *)&value, sizeof (value));
+	g_object_unref (info);
+
+	buffer = g_malloc (CACHE_KEY_SAMPLE_SIZE);
+	cache_key_add_sample (checksum, G_INPUT_STREAM (stream), buffer);
+	if (size > CACHE_KEY_SAMPLE_SIZE &&
+	    g_seekable_seek (G_SEEKABLE (stream),
+			     MAX (CACHE_KEY_SAMPLE_SIZE, size - CACHE_KEY_SAMPLE_SIZE),
+			     G_SEEK_SET, NULL, NULL)) {
+		cache_key_add_sample (checksum, G_INPUT_STREAM (stream), buffer);
+	}
+	g_free (buffer);
+	g_object_unref (stream);
+
+	key = g_strdup (g_checksum_get_string (checksum));
+	g_checksum_free (checksum);
+
+	return key;
+}
+
+/**
+ * ev_file_read_bytes:
+ * @uri: a file URI
+ * @max_size: the maximum size of the file
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Reads the whole file at @uri into memory, so that backends can parse
+ * it from a single buffer instead of doing their own buffered reads. The
+ * data is a private copy: it's not affected when the file is truncated
+ * or rewritten afterwards, unlike a file mapping, which crashes the
+ * process when read past the new end of the file.
+ *
+ * An error is returned when the file is larger than @max_size, or when
+ * its size or modification time changed while it was read.
+ *
+ * Returns: (transfer full): a #GBytes with the contents of the file,
+ *   or %NULL on error
+ *
+ * Since: 3.14
+ */
+GBytes *
+ev_file_read_bytes (const gchar *uri,
+		    goffset      max_size,
+		    GError     **error)
+{
+	GFile            *file;
+	GFileInputStream *stream;
+	GFileInfo        *info;
+	goffset           size;
+	guint64           mtime;
+	guint32           mtime_usec;
+	gchar            *data;
+	gsize             n_read;
+	gboolean          changed;
+
+	g_return_val_if_fail (uri != NULL, NULL);
+
+	file = g_file_new_for_uri (uri);
+	stream = g_file_read (file, NULL, error);
+	g_object_unref (file);
+	if (!stream)
+		return NULL;
+
+	info = g_file_input_stream_query_info (stream,
+					       G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+					       G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+					       G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+					       NULL, error);
+	if (!info) {
+		g_object_unref (stream);
+		return NULL;
+	}
+
+	size = g_file_info_get_size (info);
+	mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	mtime_usec = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	g_object_unref (info);
+
+	if (size > max_size) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "File too large to be read into memory");
+		g_object_unref (stream);
+		return NULL;
+	}
+
+	data = g_malloc (size);
+	if (!g_input_stream_read_all (G_INPUT_STREAM (stream), data, size,
+				      &n_read, NULL, error)) {
+		g_free (data);
+		g_object_unref (stream);
+		return NULL;
+	}
+
+	info = g_file_input_stream_query_info (stream,
+					       G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+					       G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+					       G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+					       NULL, error);
+	g_object_unref (stream);
+	if (!info) {
+		g_free (data);
+		return NULL;
+	}
+
+	changed = n_read != (gsize)size ||
+		g_file_info_get_size (info) != size ||
+		g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) != mtime ||
+		g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC) != mtime_usec;
+	g_object_unref (info);
+
+	if (changed) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				     "File changed while it was read");
+		g_free (data);
+		return NULL;
+	}
+
+	return g_bytes_new_take (data, size);
+}
+
 /* Compressed files support */
 
 static const char *compressor_cmds[] = {
@@ -586,23 +781,102 @@ static const char *compressor_cmds[] = {
 };
 
 #define N_ARGS      4
-#define BUFFER_SIZE 1024
+#define BUFFER_SIZE 65536
 
-static gchar *
-compression_run (const gchar       *uri,
-		 EvCompressionType  type,
-		 gboolean           compress, 
-		 GError           **error)
+static gboolean
+write_all (gint          fd,
+	   const gchar  *buf,
+	   gsize         len,
+	   GError      **error)
 {
-	gchar *argv[N_ARGS];
-	gchar *uri_dst = NULL;
-	gchar *filename, *filename_dst = NULL;
-	gchar *cmd;
-	gint   fd, pout;
-	GError *err = NULL;
+	while (len > 0) {
+		gssize bytes_written;
 
-	if (type == EV_COMPRESSION_NONE)
-		return NULL;
+		bytes_written = write (fd, buf, len);
+		if (bytes_written < 0) {
+			int errsv = errno;
+
+			if (errsv == EINTR)
+				continue;
+
+			g_set_error_literal (error, G_IO_ERROR,
+					     g_io_error_from_errno (errsv),
+					     g_strerror (errsv));
+			return FALSE;
+		}
+
+		buf += bytes_written;
+		len -= bytes_written;
+	}
+
+	return TRUE;
+}
+
+/* gzip is handled in process with zlib, streaming the data from the
+ * source file to @fd without spawning any helper
+ */
+static gboolean
+compression_run_gzip (const gchar *uri,
+		      gint         fd,
+		      gboolean     compress,
+		      GError     **error)
+{
+	GFile            *file;
+	GFileInputStream *file_stream;
+	GConverter       *converter;
+	GInputStream     *stream;
+	gchar            *buf;
+	gssize            bytes_read;
+	gboolean          retval = TRUE;
+
+	file = g_file_new_for_uri (uri);
+	file_stream = g_file_read (file, NULL, error);
+	g_object_unref (file);
+	if (!file_stream)
+		return FALSE;
+
+	if (compress)
+		converter = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+	else
+		converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+	stream = g_converter_input_stream_new (G_INPUT_STREAM (file_stream), converter);
+	g_object_unref (converter);
+	g_object_unref (file_stream);
+
+	buf = g_malloc (BUFFER_SIZE);
+	do {
+		bytes_read = g_input_stream_read (stream, buf, BUFFER_SIZE, NULL, error);
+		if (bytes_read < 0 || !write_all (fd, buf, bytes_read, error)) {
+			retval = FALSE;
+			break;
+		}
+	} while (bytes_read > 0);
+
+	g_free (buf);
+	g_object_unref (stream);
+
+	return retval;
+}
+
+static void
+compression_child_setup (gpointer user_data)
+{
+	/* Make the command write its output directly to the temp file */
+	dup2 (GPOINTER_TO_INT (user_data), STDOUT_FILENO);
+}
+
+static gboolean
+compression_run_command (const gchar       *uri,
+			 gint               fd,
+			 EvCompressionType  type,
+			 gboolean           compress,
+			 GError           **error)
+{
+	gchar   *argv[N_ARGS];
+	gchar   *filename;
+	gchar   *cmd;
+	gint     exit_status;
+	gboolean retval;
 
 	cmd = g_find_program_in_path (compressor_cmds[type]);
 	if (!cmd) {
@@ -611,21 +885,13 @@ compression_run (const gchar       *uri,
 		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
 			     "Failed to find the \"%s\" command in the search path.",
                              compressor_cmds[type]);
-		return NULL;
+		return FALSE;
 	}
 
 	filename = g_filename_from_uri (uri, NULL, error);
 	if (!filename) {
 		g_free (cmd);
-		return NULL;
-	}
-
-        fd = ev_mkstemp ("comp.XXXXXX", &filename_dst, error);
-	if (fd == -1) {
-		g_free (cmd);
-		g_free (filename);
-
-		return NULL;
+		return FALSE;
 	}
 
 	argv[0] = cmd;
@@ -633,51 +899,50 @@ compression_run (const gchar       *uri,
 	argv[2] = filename;
 	argv[3] = NULL;
 
-	if (g_spawn_async_with_pipes (NULL, argv, NULL,
-				      G_SPAWN_STDERR_TO_DEV_NULL,
-				      NULL, NULL, NULL,
-				      NULL, &pout, NULL, &err)) {
-		GIOChannel *in, *out;
-		gchar buf[BUFFER_SIZE];
-		GIOStatus read_st, write_st;
-		gsize bytes_read, bytes_written;
-
-		in = g_io_channel_unix_new (pout);
-		g_io_channel_set_encoding (in, NULL, NULL);
-		out = g_io_channel_unix_new (fd);
-		g_io_channel_set_encoding (out, NULL, NULL);
-
-		do {
-			read_st = g_io_channel_read_chars (in, buf,
-							   BUFFER_SIZE,
-							   &bytes_read,
-							   error);
-			if (read_st == G_IO_STATUS_NORMAL) {
-				write_st = g_io_channel_write_chars (out, buf,
-								     bytes_read,
-								     &bytes_written,
-								     error);
-				if (write_st == G_IO_STATUS_ERROR)
-					break;
-			} else if (read_st == G_IO_STATUS_ERROR) {
-				break;
-			}
-		} while (bytes_read > 0);
-
-		g_io_channel_unref (in);
-		g_io_channel_unref (out);
-	}
+	retval = g_spawn_sync (NULL, argv, NULL,
+			       G_SPAWN_STDERR_TO_DEV_NULL,
+			       compression_child_setup, GINT_TO_POINTER (fd),
+			       NULL, NULL, &exit_status, error);
+	if (retval)
+		retval = g_spawn_check_exit_status (exit_status, error);
+
+	g_free (cmd);
+	g_free (filename);
+
+	return retval;
+}
+
+static gchar *
+compression_run (const gchar       *uri,
+		 EvCompressionType  type,
+		 gboolean           compress, 
+		 GError           **error)
+{
+	gchar   *uri_dst = NULL;
+	gchar   *filename_dst = NULL;
+	gint     fd;
+	gboolean retval;
+
+	if (type == EV_COMPRESSION_NONE)
+		return NULL;
+
+        fd = ev_mkstemp ("comp.XXXXXX", &filename_dst, error);
+	if (fd == -1)
+		return NULL;
+
+	if (type == EV_COMPRESSION_GZIP)
+		retval = compression_run_gzip (uri, fd, compress, error);
+	else
+		retval = compression_run_command (uri, fd, type, compress, error);
 
 	close (fd);
 
-	if (err) {
-		g_propagate_error (error, err);
-	} else {
+	if (retval) {
 		uri_dst = g_filename_to_uri (filename_dst, NULL, error);
+	} else {
+		g_unlink (filename_dst);
 	}
 
-	g_free (cmd);
-	g_free (filename);
 	g_free (filename_dst);
 
 	return uri_dst;
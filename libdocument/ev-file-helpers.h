@@ -62,6 +62,13 @@ gchar       *ev_file_get_mime_type    (const gchar       *uri,
 				       gboolean           fast,
 				       GError           **error);
 
+gchar       *ev_file_get_cache_key    (const gchar       *uri,
+				       GError           **error);
+
+GBytes      *ev_file_read_bytes       (const gchar       *uri,
+				       goffset            max_size,
+				       GError           **error);
+
 gchar       *ev_file_uncompress       (const gchar       *uri,
 				       EvCompressionType  type,
 				       GError           **error);
@@ -0,0 +1,485 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* The find index keeps the normalized text of every page of a document so
+ * that EvJobFind can skip the pages that can't contain the search string
+ * without going to the backend. Once all the pages have been indexed, the
+ * index is written to the user cache directory from a thread, keyed by
+ * ev_document_get_cache_key(), and mapped back into memory the next time
+ * the same document is opened. Documents without a key, like those that
+ * needed a password, are only indexed in memory. Like sidebar thumbnails,
+ * the least recently used indexes are removed when the cache grows beyond
+ * EV_FIND_INDEX_MAX_SIZE.
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "ev-find-index.h"
+#include "ev-debug.h"
+
+#define EV_FIND_INDEX_MAGIC      "EVFINDX1"
+#define EV_FIND_INDEX_BYTE_ORDER 0x01020304
+#define EV_FIND_INDEX_MAX_SIZE   (32 * 1024 * 1024)
+#define EV_FIND_INDEX_DATA_KEY   "ev-find-index"
+
+typedef struct {
+	gchar   magic[8];
+	guint32 byte_order;
+	guint32 n_pages;
+} EvFindIndexHeader;
+
+typedef struct {
+	gchar      *filename;
+	GByteArray *data;
+} EvFindIndexSaveData;
+
+typedef struct {
+	gchar  *filename;
+	time_t  mtime;
+	goffset size;
+} EvFindIndexFile;
+
+struct _EvFindIndex {
+	GMutex        mutex;
+
+	gchar        *filename;
+	gint          n_pages;
+	gint          n_indexed;
+	gboolean      dirty;
+
+	GMappedFile  *mapped_file;
+	const gchar **pages;
+	gchar       **owned_pages;
+};
+
+static void
+ev_find_index_free (EvFindIndex *index)
+{
+	gint i;
+
+	if (index->owned_pages) {
+		for (i = 0; i < index->n_pages; i++)
+			g_free (index->owned_pages[i]);
+		g_free (index->owned_pages);
+	}
+
+	if (index->mapped_file)
+		g_mapped_file_unref (index->mapped_file);
+
+	g_free (index->pages);
+	g_free (index->filename);
+	g_mutex_clear (&index->mutex);
+	g_free (index);
+}
+
+static gchar *
+ev_find_index_get_root (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "evince", "find-index", NULL);
+}
+
+static gboolean
+ev_find_index_load (EvFindIndex *index)
+{
+	GMappedFile       *mapped_file;
+	EvFindIndexHeader *header;
+	const guint32     *offsets;
+	const gchar       *contents;
+	gsize              length;
+	gsize              data_start;
+	gint               i;
+
+	mapped_file = g_mapped_file_new (index->filename, FALSE, NULL);
+	if (!mapped_file)
+		return FALSE;
+
+	contents = g_mapped_file_get_contents (mapped_file);
+	length = g_mapped_file_get_length (mapped_file);
+	header = (EvFindIndexHeader *)contents;
+	data_start = sizeof (EvFindIndexHeader) + index->n_pages * sizeof (guint32);
+
+	/* Every page string is nul-terminated, so the last byte of a
+	 * valid index is always a nul character.
+	 */
+	if (length <= data_start ||
+	    contents[length - 1] != '\0' ||
+	    memcmp (header->magic, EV_FIND_INDEX_MAGIC, sizeof (header->magic)) != 0 ||
+	    header->byte_order != EV_FIND_INDEX_BYTE_ORDER ||
+	    header->n_pages != (guint32)index->n_pages) {
+		g_mapped_file_unref (mapped_file);
+		return FALSE;
+	}
+
+	offsets = (const guint32 *)(contents + sizeof (EvFindIndexHeader));
+	for (i = 0; i < index->n_pages; i++) {
+		if (offsets[i] >= length - data_start) {
+			g_mapped_file_unref (mapped_file);
+			return FALSE;
+		}
+		index->pages[i] = contents + data_start + offsets[i];
+	}
+
+	index->mapped_file = mapped_file;
+	index->n_indexed = index->n_pages;
+
+	/* Mark it as recently used */
+	g_utime (index->filename, NULL);
+
+	return TRUE;
+}
+
+/* Documents loaded from a stream only get a cache key once the stream
+ * has been copied to a local file, so this is tried again until it
+ * succeeds.
+ */
+static void
+ev_find_index_setup_file (EvFindIndex *index,
+			  EvDocument  *document)
+{
+	const gchar *key;
+	gchar       *root;
+
+	key = ev_document_get_cache_key (document);
+	if (!key)
+		return;
+
+	/* A search might be adding pages from its thread. Pages indexed
+	 * in the meantime are kept, they will be saved when complete.
+	 */
+	g_mutex_lock (&index->mutex);
+	if (!index->filename) {
+		root = ev_find_index_get_root ();
+		index->filename = g_build_filename (root, key, NULL);
+		g_free (root);
+
+		if (index->n_indexed == 0 && ev_find_index_load (index))
+			ev_debug_message (DEBUG_JOBS, "find index loaded from %s", index->filename);
+	}
+	g_mutex_unlock (&index->mutex);
+}
+
+static EvFindIndex *
+ev_find_index_new (EvDocument *document)
+{
+	EvFindIndex *index;
+
+	index = g_new0 (EvFindIndex, 1);
+	g_mutex_init (&index->mutex);
+	index->n_pages = ev_document_get_n_pages (document);
+	index->pages = g_new0 (const gchar *, index->n_pages);
+
+	ev_find_index_setup_file (index, document);
+
+	return index;
+}
+
+/*
+ * ev_find_index_get_for_document:
+ * @document: an #EvDocument
+ *
+ * Returns: (transfer none): the find index of @document. It's created, and
+ *   loaded from the cache if possible, the first time it's requested.
+ */
+EvFindIndex *
+ev_find_index_get_for_document (EvDocument *document)
+{
+	EvFindIndex *index;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+
+	index = g_object_get_data (G_OBJECT (document), EV_FIND_INDEX_DATA_KEY);
+	if (index) {
+		ev_find_index_setup_file (index, document);
+		return index;
+	}
+
+	index = ev_find_index_new (document);
+	g_object_set_data_full (G_OBJECT (document), EV_FIND_INDEX_DATA_KEY,
+				index, (GDestroyNotify)ev_find_index_free);
+
+	return index;
+}
+
+/*
+ * ev_find_index_normalize:
+ * @text: UTF-8 text
+ *
+ * Normalizes @text the same way page texts are stored in the index:
+ * compatibility decomposed, case folded and without white spaces. The
+ * index is only used to discard pages, so it doesn't matter that the
+ * result is more permissive than the search options used by the backends.
+ *
+ * Returns: a newly allocated string, or %NULL if @text is not valid UTF-8
+ */
+gchar *
+ev_find_index_normalize (const gchar *text)
+{
+	gchar       *normalized;
+	gchar       *folded;
+	GString     *retval;
+	const gchar *p;
+
+	normalized = g_utf8_normalize (text, -1, G_NORMALIZE_ALL);
+	if (!normalized)
+		return NULL;
+
+	folded = g_utf8_casefold (normalized, -1);
+	g_free (normalized);
+
+	retval = g_string_sized_new (strlen (folded));
+	for (p = folded; *p; p = g_utf8_next_char (p)) {
+		gunichar c = g_utf8_get_char (p);
+
+		if (!g_unichar_isspace (c))
+			g_string_append_unichar (retval, c);
+	}
+	g_free (folded);
+
+	return g_string_free (retval, FALSE);
+}
+
+gboolean
+ev_find_index_has_page (EvFindIndex *index,
+			gint         page)
+{
+	gboolean retval;
+
+	g_mutex_lock (&index->mutex);
+	retval = index->pages[page] != NULL;
+	g_mutex_unlock (&index->mutex);
+
+	return retval;
+}
+
+/*
+ * ev_find_index_page_may_match:
+ * @index: an #EvFindIndex
+ * @page: the page index
+ * @normalized_text: the search string as returned by ev_find_index_normalize()
+ *
+ * Returns: %FALSE if @page is known not to contain @normalized_text,
+ *   %TRUE if it might contain it or the page hasn't been indexed yet.
+ */
+gboolean
+ev_find_index_page_may_match (EvFindIndex *index,
+			      gint         page,
+			      const gchar *normalized_text)
+{
+	gboolean retval = TRUE;
+
+	if (!normalized_text || normalized_text[0] == '\0')
+		return TRUE;
+
+	g_mutex_lock (&index->mutex);
+	if (index->pages[page])
+		retval = strstr (index->pages[page], normalized_text) != NULL;
+	g_mutex_unlock (&index->mutex);
+
+	return retval;
+}
+
+void
+ev_find_index_add_page (EvFindIndex *index,
+			gint         page,
+			const gchar *text)
+{
+	gchar *normalized;
+
+	g_return_if_fail (page >= 0 && page < index->n_pages);
+
+	normalized = ev_find_index_normalize (text ? text : "");
+	if (!normalized)
+		return;
+
+	g_mutex_lock (&index->mutex);
+	if (index->pages[page]) {
+		g_mutex_unlock (&index->mutex);
+		g_free (normalized);
+		return;
+	}
+
+	if (!index->owned_pages)
+		index->owned_pages = g_new0 (gchar *, index->n_pages);
+	index->owned_pages[page] = normalized;
+	index->pages[page] = normalized;
+	index->n_indexed++;
+	index->dirty = TRUE;
+	g_mutex_unlock (&index->mutex);
+}
+
+gboolean
+ev_find_index_is_complete (EvFindIndex *index)
+{
+	gboolean retval;
+
+	g_mutex_lock (&index->mutex);
+	retval = index->n_indexed == index->n_pages;
+	g_mutex_unlock (&index->mutex);
+
+	return retval;
+}
+
+static gint
+compare_files_by_mtime (const EvFindIndexFile *a,
+			const EvFindIndexFile *b)
+{
+	return a->mtime < b->mtime ? -1 : a->mtime > b->mtime ? 1 : 0;
+}
+
+/* Removes the least recently used indexes until the cache is back to
+ * three quarters of its maximum size.
+ */
+static void
+ev_find_index_trim (void)
+{
+	GArray      *files;
+	GDir        *dir;
+	gchar       *root;
+	const gchar *name;
+	goffset      total_size = 0;
+	guint        i;
+
+	root = ev_find_index_get_root ();
+	dir = g_dir_open (root, 0, NULL);
+	if (!dir) {
+		g_free (root);
+		return;
+	}
+
+	files = g_array_new (FALSE, FALSE, sizeof (EvFindIndexFile));
+	while ((name = g_dir_read_name (dir))) {
+		EvFindIndexFile file;
+		GStatBuf        statbuf;
+
+		file.filename = g_build_filename (root, name, NULL);
+		if (g_stat (file.filename, &statbuf) == -1) {
+			g_free (file.filename);
+			continue;
+		}
+
+		file.mtime = statbuf.st_mtime;
+		file.size = statbuf.st_size;
+		total_size += file.size;
+		g_array_append_val (files, file);
+	}
+	g_dir_close (dir);
+
+	if (total_size > EV_FIND_INDEX_MAX_SIZE) {
+		g_array_sort (files, (GCompareFunc)compare_files_by_mtime);
+		for (i = 0; i < files->len && total_size > EV_FIND_INDEX_MAX_SIZE / 4 * 3; i++) {
+			EvFindIndexFile *file = &g_array_index (files, EvFindIndexFile, i);
+
+			if (g_unlink (file->filename) == 0)
+				total_size -= file->size;
+		}
+	}
+
+	for (i = 0; i < files->len; i++)
+		g_free (g_array_index (files, EvFindIndexFile, i).filename);
+	g_array_free (files, TRUE);
+	g_free (root);
+}
+
+static void
+ev_find_index_save_data_free (EvFindIndexSaveData *data)
+{
+	g_free (data->filename);
+	g_byte_array_free (data->data, TRUE);
+	g_slice_free (EvFindIndexSaveData, data);
+}
+
+static void
+save_thread (GTask               *task,
+	     gpointer             source_object,
+	     EvFindIndexSaveData *data,
+	     GCancellable        *cancellable)
+{
+	gchar  *dirname;
+	GError *error = NULL;
+
+	dirname = g_path_get_dirname (data->filename);
+	if (g_mkdir_with_parents (dirname, 0700) == -1 ||
+	    !g_file_set_contents (data->filename, (const gchar *)data->data->data,
+				  data->data->len, &error)) {
+		ev_debug_message (DEBUG_JOBS, "failed to save find index %s: %s",
+				  data->filename, error ? error->message : g_strerror (errno));
+		g_clear_error (&error);
+		g_free (dirname);
+		return;
+	}
+	g_free (dirname);
+
+	ev_find_index_trim ();
+}
+
+/*
+ * ev_find_index_save:
+ * @index: an #EvFindIndex
+ *
+ * Writes @index to the cache in a thread if all the pages have been
+ * indexed and it hasn't been saved yet. Errors are not fatal, the index
+ * will just be built again the next time the document is searched.
+ */
+void
+ev_find_index_save (EvFindIndex *index)
+{
+	EvFindIndexHeader    header;
+	EvFindIndexSaveData *save_data;
+	GByteArray          *data;
+	guint32             *offsets;
+	GTask               *task;
+	gint                 i;
+
+	g_mutex_lock (&index->mutex);
+	if (!index->filename || !index->dirty || index->n_indexed != index->n_pages) {
+		g_mutex_unlock (&index->mutex);
+		return;
+	}
+
+	memcpy (header.magic, EV_FIND_INDEX_MAGIC, sizeof (header.magic));
+	header.byte_order = EV_FIND_INDEX_BYTE_ORDER;
+	header.n_pages = index->n_pages;
+
+	offsets = g_new (guint32, index->n_pages);
+	data = g_byte_array_new ();
+	for (i = 0; i < index->n_pages; i++) {
+		offsets[i] = data->len;
+		g_byte_array_append (data, (const guint8 *)index->pages[i],
+				     strlen (index->pages[i]) + 1);
+	}
+
+	g_byte_array_prepend (data, (const guint8 *)offsets, index->n_pages * sizeof (guint32));
+	g_byte_array_prepend (data, (const guint8 *)&header, sizeof (header));
+	g_free (offsets);
+
+	index->dirty = FALSE;
+
+	save_data = g_slice_new (EvFindIndexSaveData);
+	save_data->filename = g_strdup (index->filename);
+	save_data->data = data;
+	g_mutex_unlock (&index->mutex);
+
+	task = g_task_new (NULL, NULL, NULL, NULL);
+	g_task_set_task_data (task, save_data, (GDestroyNotify)ev_find_index_save_data_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc)save_thread);
+	g_object_unref (task);
+}
@@ -0,0 +1,47 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (EVINCE_COMPILATION)
+#error "This is a private header."
+#endif
+
+#ifndef EV_FIND_INDEX_H
+#define EV_FIND_INDEX_H
+
+#include <glib.h>
+#include <evince-document.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EvFindIndex EvFindIndex;
+
+EvFindIndex *ev_find_index_get_for_document (EvDocument  *document);
+gchar       *ev_find_index_normalize        (const gchar *text);
+gboolean     ev_find_index_has_page         (EvFindIndex *index,
+					     gint         page);
+gboolean     ev_find_index_page_may_match   (EvFindIndex *index,
+					     gint         page,
+					     const gchar *normalized_text);
+void         ev_find_index_add_page         (EvFindIndex *index,
+					     gint         page,
+					     const gchar *text);
+gboolean     ev_find_index_is_complete      (EvFindIndex *index);
+void         ev_find_index_save             (EvFindIndex *index);
+
+G_END_DECLS
+
+#endif /* EV_FIND_INDEX_H */
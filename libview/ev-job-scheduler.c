@@ -82,6 +82,24 @@ ev_job_queue_get_next_unlocked (void)
 	return job;
 }
 
+static gboolean
+ev_job_queue_has_more_urgent_job (EvJobPriority priority)
+{
+	gboolean retval = FALSE;
+	gint     i;
+
+	g_mutex_lock (&job_queue_mutex);
+	for (i = EV_JOB_PRIORITY_URGENT; i < priority; i++) {
+		if (!g_queue_is_empty (job_queue[i])) {
+			retval = TRUE;
+			break;
+		}
+	}
+	g_mutex_unlock (&job_queue_mutex);
+
+	return retval;
+}
+
 static gpointer
 ev_job_scheduler_init (gpointer data)
 {
@@ -169,9 +187,14 @@ ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 	}
 }
 
-static void
-ev_job_thread (EvJob *job)
+/* Runs @s_job until it finishes or, for jobs that run in several steps,
+ * until a job with a higher priority is queued. Returns %TRUE when the
+ * job yielded and has to be resumed later.
+ */
+static gboolean
+ev_job_thread (EvSchedulerJob *s_job)
 {
+	EvJob   *job = s_job->job;
 	gboolean result;
 
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job));
@@ -183,9 +206,11 @@ ev_job_thread (EvJob *job)
                         g_atomic_pointer_set (&running_job, job);
 			result = ev_job_run (job);
                 }
-	} while (result);
+	} while (result && !ev_job_queue_has_more_urgent_job (s_job->priority));
 
         g_atomic_pointer_set (&running_job, NULL);
+
+	return result;
 }
 
 static gboolean
@@ -213,9 +238,18 @@ ev_job_thread_proxy (gpointer data)
 			continue;
 		}
 		g_mutex_unlock (&job_queue_mutex);
-		
-		ev_job_thread (job->job);
-		ev_scheduler_job_destroy (job);
+
+		if (ev_job_thread (job)) {
+			ev_debug_message (DEBUG_JOBS, "%s yields to a more urgent job",
+					  EV_GET_TYPE_NAME (job->job));
+
+			/* Resume it before any other job with the same priority */
+			g_mutex_lock (&job_queue_mutex);
+			g_queue_push_head (job_queue[job->priority], job);
+			g_mutex_unlock (&job_queue_mutex);
+		} else {
+			ev_scheduler_job_destroy (job);
+		}
 	}
 
 	return NULL;
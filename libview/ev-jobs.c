@@ -36,9 +36,11 @@
 #include "ev-document-annotations.h"
 #include "ev-document-attachments.h"
 #include "ev-document-text.h"
+#include "ev-find-index.h"
 #include "ev-debug.h"
 
 #include <errno.h>
+#include <string.h>
 #include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
 #include <unistd.h>
@@ -86,9 +88,15 @@ enum {
 	FIND_LAST_SIGNAL
 };
 
+enum {
+	ANNOTS_UPDATED,
+	ANNOTS_LAST_SIGNAL
+};
+
 static guint job_signals[LAST_SIGNAL] = { 0 };
 static guint job_fonts_signals[FONTS_LAST_SIGNAL] = { 0 };
 static guint job_find_signals[FIND_LAST_SIGNAL] = { 0 };
+static guint job_annots_signals[ANNOTS_LAST_SIGNAL] = { 0 };
 
 G_DEFINE_ABSTRACT_TYPE (EvJob, ev_job, G_TYPE_OBJECT)
 G_DEFINE_TYPE (EvJobLinks, ev_job_links, EV_TYPE_JOB)
@@ -501,10 +509,13 @@ ev_job_attachments_new (EvDocument *document)
 }
 
 /* EvJobAnnots */
+#define ANNOTS_CHUNK_SIZE 20
+
 static void
 ev_job_annots_init (EvJobAnnots *job)
 {
 	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+	g_mutex_init (&job->mutex);
 }
 
 static void
@@ -522,20 +533,84 @@ ev_job_annots_dispose (GObject *object)
 		job->annots = NULL;
 	}
 
+	if (job->pending_annots) {
+		g_list_foreach (job->pending_annots, (GFunc)ev_mapping_list_unref, NULL);
+		g_list_free (job->pending_annots);
+		job->pending_annots = NULL;
+	}
+
 	G_OBJECT_CLASS (ev_job_annots_parent_class)->dispose (object);
 }
 
+static void
+ev_job_annots_finalize (GObject *object)
+{
+	EvJobAnnots *job = EV_JOB_ANNOTS (object);
+
+	g_mutex_clear (&job->mutex);
+
+	G_OBJECT_CLASS (ev_job_annots_parent_class)->finalize (object);
+}
+
+/* Moves the annotations found by the job thread since the
+ * last update to the annots list and notifies them.
+ */
+static void
+ev_job_annots_flush_pending (EvJobAnnots *job)
+{
+	GList *pending;
+
+	g_mutex_lock (&job->mutex);
+	pending = job->pending_annots;
+	job->pending_annots = NULL;
+	g_mutex_unlock (&job->mutex);
+
+	if (!pending)
+		return;
+
+	job->annots = g_list_concat (job->annots, pending);
+	g_signal_emit (job, job_annots_signals[ANNOTS_UPDATED], 0, pending);
+}
+
+static gboolean
+ev_job_annots_updated_idle (EvJobAnnots *job)
+{
+	g_mutex_lock (&job->mutex);
+	job->updated_idle_id = 0;
+	g_mutex_unlock (&job->mutex);
+
+	if (!g_cancellable_is_cancelled (EV_JOB (job)->cancellable))
+		ev_job_annots_flush_pending (job);
+
+	return FALSE;
+}
+
+/* Annotations are retrieved in chunks of pages so that the document
+ * lock is released regularly, and the job yields to more urgent jobs
+ * (see ev_job_scheduler) between chunks instead of blocking the
+ * rendering of the visible pages until the whole document is scanned.
+ */
 static gboolean
 ev_job_annots_run (EvJob *job)
 {
 	EvJobAnnots *job_annots = EV_JOB_ANNOTS (job);
+	GList       *chunk = NULL;
+	gint         n_pages;
+	gint         last_page;
 	gint         i;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
-	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+#ifdef EV_ENABLE_DEBUG
+	/* We use the #ifdef in this case because of the if */
+	if (job_annots->current_page == 0)
+		ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+#endif
+
+	n_pages = ev_document_get_n_pages (job->document);
+	last_page = MIN (job_annots->current_page + ANNOTS_CHUNK_SIZE, n_pages);
 
 	ev_document_doc_mutex_lock ();
-	for (i = 0; i < ev_document_get_n_pages (job->document); i++) {
+	for (i = job_annots->current_page; i < last_page; i++) {
 		EvMappingList *mapping_list;
 		EvPage        *page;
 
@@ -545,17 +620,43 @@ ev_job_annots_run (EvJob *job)
 		g_object_unref (page);
 
 		if (mapping_list)
-			job_annots->annots = g_list_prepend (job_annots->annots, mapping_list);
+			chunk = g_list_prepend (chunk, mapping_list);
 	}
 	ev_document_doc_mutex_unlock ();
 
-	job_annots->annots = g_list_reverse (job_annots->annots);
+	job_annots->current_page = last_page;
+
+	if (chunk) {
+		g_mutex_lock (&job_annots->mutex);
+		job_annots->pending_annots = g_list_concat (job_annots->pending_annots,
+							    g_list_reverse (chunk));
+		if (job_annots->updated_idle_id == 0 && last_page < n_pages) {
+			job_annots->updated_idle_id =
+				g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+						 (GSourceFunc)ev_job_annots_updated_idle,
+						 g_object_ref (job_annots),
+						 (GDestroyNotify)g_object_unref);
+		}
+		g_mutex_unlock (&job_annots->mutex);
+	}
+
+	if (last_page < n_pages)
+		return TRUE;
 
 	ev_job_succeeded (job);
 
 	return FALSE;
 }
 
+static void
+ev_job_annots_finished (EvJob *job)
+{
+	/* Make sure all the annotations have been notified
+	 * and added to the annots list before finishing.
+	 */
+	ev_job_annots_flush_pending (EV_JOB_ANNOTS (job));
+}
+
 static void
 ev_job_annots_class_init (EvJobAnnotsClass *class)
 {
@@ -563,7 +664,19 @@ ev_job_annots_class_init (EvJobAnnotsClass *class)
 	EvJobClass   *job_class = EV_JOB_CLASS (class);
 
 	oclass->dispose = ev_job_annots_dispose;
+	oclass->finalize = ev_job_annots_finalize;
 	job_class->run = ev_job_annots_run;
+	job_class->finished = ev_job_annots_finished;
+
+	job_annots_signals[ANNOTS_UPDATED] =
+		g_signal_new ("updated",
+			      EV_TYPE_JOB_ANNOTS,
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvJobAnnotsClass, updated),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE,
+			      1, G_TYPE_POINTER);
 }
 
 EvJob *
@@ -635,7 +748,11 @@ ev_job_render_run (EvJob *job)
 					   job_render->target_width, job_render->target_height);
 	g_object_unref (ev_page);
 
-	job_render->surface = ev_document_render (job->document, rc);
+	if (job_render->has_region)
+		job_render->surface = ev_document_render_region (job->document, rc,
+								 &(job_render->region));
+	else
+		job_render->surface = ev_document_render (job->document, rc);
 	/* If job was cancelled during the page rendering,
 	 * we return now, so that the thread is finished ASAP
 	 */
@@ -647,7 +764,10 @@ ev_job_render_run (EvJob *job)
 		return FALSE;
 	}
 
-	if (job_render->include_selection && EV_IS_SELECTION (job->document)) {
+	/* Selections are rendered for the whole page, region renders are
+	 * only used when the page is too large for that */
+	if (job_render->include_selection && !job_render->has_region &&
+	    EV_IS_SELECTION (job->document)) {
 		ev_selection_render_selection (EV_SELECTION (job->document),
 					       rc,
 					       &(job_render->selection),
@@ -721,6 +841,25 @@ ev_job_render_set_selection_info (EvJobRender     *job,
 	job->base = *base;
 }
 
+/**
+ * ev_job_render_set_region:
+ * @job: an #EvJobRender
+ * @region: the area of the page to render, in pixels of the page at the
+ *   job target size
+ *
+ * Makes @job render only @region of the page, the resulting surface has
+ * the size of @region. The selection is not rendered for region jobs.
+ *
+ * Since: 3.14
+ */
+void
+ev_job_render_set_region (EvJobRender           *job,
+			  cairo_rectangle_int_t *region)
+{
+	job->has_region = TRUE;
+	job->region = *region;
+}
+
 /* EvJobPageData */
 static void
 ev_job_page_data_init (EvJobPageData *job)
@@ -1053,14 +1192,30 @@ ev_job_load_dispose (GObject *object)
 	(* G_OBJECT_CLASS (ev_job_load_parent_class)->dispose) (object);
 }
 
+static gchar *
+ev_job_load_get_cache_key (EvJobLoad *job)
+{
+	/* Nothing is cached for documents that needed a password */
+	if (job->password || !g_str_has_prefix (job->uri, "file://"))
+		return NULL;
+
+	return ev_file_get_cache_key (job->uri, NULL);
+}
+
 static gboolean
 ev_job_load_run (EvJob *job)
 {
 	EvJobLoad *job_load = EV_JOB_LOAD (job);
 	GError    *error = NULL;
+	gchar     *cache_key;
 	
 	ev_debug_message (DEBUG_JOBS, "%s", job_load->uri);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+
+	/* The key must describe the contents that are actually loaded,
+	 * so it's discarded if the file changes while loading it
+	 */
+	cache_key = ev_job_load_get_cache_key (job_load);
 	
 	ev_document_fc_mutex_lock ();
 
@@ -1091,6 +1246,15 @@ ev_job_load_run (EvJob *job)
 
 	ev_document_fc_mutex_unlock ();
 
+	if (!error && cache_key) {
+		gchar *loaded_key = ev_job_load_get_cache_key (job_load);
+
+		if (g_strcmp0 (cache_key, loaded_key) == 0)
+			ev_document_set_cache_key (job->document, cache_key);
+		g_free (loaded_key);
+	}
+	g_free (cache_key);
+
 	if (error) {
 		ev_job_failed_from_error (job, error);
 		g_error_free (error);
@@ -1582,16 +1746,52 @@ ev_job_save_new (EvDocument  *document,
 }
 
 /* EvJobFind */
+typedef struct {
+	gchar        *normalized_text;
+	EvFindIndex  *find_index;
+	gboolean     *candidates;
+
+	/* Only used by the job thread */
+	gint          n_searched;
+
+	/* Only used in the main loop */
+	gint          n_reported;
+
+	/* Results passed from the job thread to the main loop */
+	GMutex        mutex;
+	GList       **results;
+	gboolean     *pages_done;
+	guint         flush_idle_id;
+} EvJobFindPrivate;
+
+#define EV_JOB_FIND_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), EV_TYPE_JOB_FIND, EvJobFindPrivate))
+
 static void
 ev_job_find_init (EvJobFind *job)
 {
-	EV_JOB (job)->run_mode = EV_JOB_RUN_MAIN_LOOP;
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+	g_mutex_init (&EV_JOB_FIND_GET_PRIVATE (job)->mutex);
+}
+
+static void
+free_find_results (GList **results,
+		   gint    n_pages)
+{
+	gint i;
+
+	for (i = 0; i < n_pages; i++) {
+		g_list_foreach (results[i], (GFunc)ev_rectangle_free, NULL);
+		g_list_free (results[i]);
+	}
+
+	g_free (results);
 }
 
 static void
 ev_job_find_dispose (GObject *object)
 {
-	EvJobFind *job = EV_JOB_FIND (object);
+	EvJobFind        *job = EV_JOB_FIND (object);
+	EvJobFindPrivate *priv = EV_JOB_FIND_GET_PRIVATE (job);
 
 	ev_debug_message (DEBUG_JOBS, NULL);
 
@@ -1601,61 +1801,180 @@ ev_job_find_dispose (GObject *object)
 	}
 
 	if (job->pages) {
-		gint i;
+		free_find_results (job->pages, job->n_pages);
+		job->pages = NULL;
+	}
 
-		for (i = 0; i < job->n_pages; i++) {
-			g_list_foreach (job->pages[i], (GFunc)ev_rectangle_free, NULL);
-			g_list_free (job->pages[i]);
-		}
+	if (priv->normalized_text) {
+		g_free (priv->normalized_text);
+		priv->normalized_text = NULL;
+	}
 
-		g_free (job->pages);
-		job->pages = NULL;
+	if (priv->results) {
+		free_find_results (priv->results, job->n_pages);
+		priv->results = NULL;
+	}
+
+	if (priv->pages_done) {
+		g_free (priv->pages_done);
+		priv->pages_done = NULL;
+	}
+
+	if (priv->candidates) {
+		g_free (priv->candidates);
+		priv->candidates = NULL;
 	}
 	
 	(* G_OBJECT_CLASS (ev_job_find_parent_class)->dispose) (object);
 }
 
+static void
+ev_job_find_finalize (GObject *object)
+{
+	g_mutex_clear (&EV_JOB_FIND_GET_PRIVATE (object)->mutex);
+
+	(* G_OBJECT_CLASS (ev_job_find_parent_class)->finalize) (object);
+}
+
+/* Reports the pages searched by the job thread since the last update.
+ * Results are reported in page order starting at start_page, so that
+ * ev_job_find_get_progress() and the users of the updated signal keep
+ * working as with a main loop search.
+ */
+static void
+ev_job_find_flush_results (EvJobFind *job_find)
+{
+	EvJobFindPrivate *priv = EV_JOB_FIND_GET_PRIVATE (job_find);
+
+	while (priv->n_reported < job_find->n_pages) {
+		GList   *matches;
+		gboolean done;
+
+		g_mutex_lock (&priv->mutex);
+		done = priv->pages_done[job_find->current_page];
+		matches = priv->results[job_find->current_page];
+		priv->results[job_find->current_page] = NULL;
+		g_mutex_unlock (&priv->mutex);
+
+		if (!done)
+			break;
+
+		if (!job_find->has_results)
+			job_find->has_results = (matches != NULL);
+
+		job_find->pages[job_find->current_page] = matches;
+		priv->n_reported++;
+		g_signal_emit (job_find, job_find_signals[FIND_UPDATED], 0, job_find->current_page);
+
+		job_find->current_page = (job_find->current_page + 1) % job_find->n_pages;
+	}
+}
+
+static gboolean
+ev_job_find_flush_idle (EvJobFind *job_find)
+{
+	EvJobFindPrivate *priv = EV_JOB_FIND_GET_PRIVATE (job_find);
+
+	g_mutex_lock (&priv->mutex);
+	priv->flush_idle_id = 0;
+	g_mutex_unlock (&priv->mutex);
+
+	if (!g_cancellable_is_cancelled (EV_JOB (job_find)->cancellable))
+		ev_job_find_flush_results (job_find);
+
+	return FALSE;
+}
+
+static GList *
+ev_job_find_search_page (EvJobFind *job_find,
+			 gint       page)
+{
+	EvJob       *job = EV_JOB (job_find);
+	EvFindIndex *index = EV_JOB_FIND_GET_PRIVATE (job_find)->find_index;
+	EvPage      *ev_page;
+	GList       *matches;
+
+	ev_document_doc_mutex_lock ();
+	ev_page = ev_document_get_page (job->document, page);
+	matches = ev_document_find_find_text_with_options (EV_DOCUMENT_FIND (job->document),
+							   ev_page, job_find->text,
+							   job_find->options);
+	if (!ev_find_index_has_page (index, page) &&
+	    EV_IS_DOCUMENT_TEXT (job->document)) {
+		gchar *text;
+
+		text = ev_document_text_get_text (EV_DOCUMENT_TEXT (job->document), ev_page);
+		ev_find_index_add_page (index, page, text);
+		g_free (text);
+	}
+	g_object_unref (ev_page);
+	ev_document_doc_mutex_unlock ();
+
+	return matches;
+}
+
+/* Pages are searched one at a time, in order from start_page, and the
+ * job yields to more urgent jobs (see ev_job_scheduler) between pages,
+ * so that searching doesn't delay the rendering of the visible pages.
+ * Pages ruled out by a previous search or by the find index are
+ * reported as empty without going to the backend.
+ */
 static gboolean
 ev_job_find_run (EvJob *job)
 {
-	EvJobFind      *job_find = EV_JOB_FIND (job);
-	EvDocumentFind *find = EV_DOCUMENT_FIND (job->document);
-	EvPage         *ev_page;
-	GList          *matches;
+	EvJobFind        *job_find = EV_JOB_FIND (job);
+	EvJobFindPrivate *priv = EV_JOB_FIND_GET_PRIVATE (job_find);
+	GList            *matches = NULL;
+	gint              page;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
-	
-	/* Do not block the main loop */
-	if (!ev_document_doc_mutex_trylock ())
-		return TRUE;
-	
+
+	if (job_find->n_pages == 0) {
+		ev_job_succeeded (job);
+
+		return FALSE;
+	}
+
 #ifdef EV_ENABLE_DEBUG
 	/* We use the #ifdef in this case because of the if */
-	if (job_find->current_page == job_find->start_page)
+	if (priv->n_searched == 0)
 		ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 #endif
 
-	ev_page = ev_document_get_page (job->document, job_find->current_page);
-	matches = ev_document_find_find_text_with_options (find, ev_page, job_find->text,
-                                                           job_find->options);
-	g_object_unref (ev_page);
-	
-	ev_document_doc_mutex_unlock ();
+	page = (job_find->start_page + priv->n_searched) % job_find->n_pages;
+	if ((!priv->candidates || priv->candidates[page]) &&
+	    ev_find_index_page_may_match (priv->find_index, page, priv->normalized_text))
+		matches = ev_job_find_search_page (job_find, page);
+	priv->n_searched++;
+
+	g_mutex_lock (&priv->mutex);
+	priv->results[page] = matches;
+	priv->pages_done[page] = TRUE;
+	if (priv->flush_idle_id == 0 && priv->n_searched < job_find->n_pages) {
+		priv->flush_idle_id =
+			g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+					 (GSourceFunc)ev_job_find_flush_idle,
+					 g_object_ref (job_find),
+					 (GDestroyNotify)g_object_unref);
+	}
+	g_mutex_unlock (&priv->mutex);
 
-	if (!job_find->has_results)
-		job_find->has_results = (matches != NULL);
+	if (priv->n_searched < job_find->n_pages)
+		return TRUE;
 
-	job_find->pages[job_find->current_page] = matches;
-	g_signal_emit (job_find, job_find_signals[FIND_UPDATED], 0, job_find->current_page);
-		       
-	job_find->current_page = (job_find->current_page + 1) % job_find->n_pages;
-	if (job_find->current_page == job_find->start_page) {
-		ev_job_succeeded (job);
+	ev_find_index_save (priv->find_index);
+	ev_job_succeeded (job);
 
-		return FALSE;
-	}
+	return FALSE;
+}
 
-	return TRUE;
+static void
+ev_job_find_finished (EvJob *job)
+{
+	/* Make sure all the pages have been reported
+	 * before the finished signal handlers run.
+	 */
+	ev_job_find_flush_results (EV_JOB_FIND (job));
 }
 
 static void
@@ -1663,9 +1982,13 @@ ev_job_find_class_init (EvJobFindClass *class)
 {
 	EvJobClass   *job_class = EV_JOB_CLASS (class);
 	GObjectClass *gobject_class = G_OBJECT_CLASS (class);
+
+	g_type_class_add_private (gobject_class, sizeof (EvJobFindPrivate));
 	
 	job_class->run = ev_job_find_run;
+	job_class->finished = ev_job_find_finished;
 	gobject_class->dispose = ev_job_find_dispose;
+	gobject_class->finalize = ev_job_find_finalize;
 	
 	job_find_signals[FIND_UPDATED] =
 		g_signal_new ("updated",
@@ -1685,11 +2008,13 @@ ev_job_find_new (EvDocument  *document,
 		 const gchar *text,
 		 gboolean     case_sensitive)
 {
-	EvJobFind *job;
+	EvJobFind        *job;
+	EvJobFindPrivate *priv;
 	
 	ev_debug_message (DEBUG_JOBS, NULL);
 	
 	job = g_object_new (EV_TYPE_JOB_FIND, NULL);
+	priv = EV_JOB_FIND_GET_PRIVATE (job);
 
 	EV_JOB (job)->document = g_object_ref (document);
 	job->start_page = start_page;
@@ -1703,9 +2028,88 @@ ev_job_find_new (EvDocument  *document,
         if (case_sensitive)
                 job->options |= EV_FIND_CASE_SENSITIVE;
 
+	priv->normalized_text = ev_find_index_normalize (text);
+	priv->find_index = ev_find_index_get_for_document (document);
+	priv->results = g_new0 (GList *, n_pages);
+	priv->pages_done = g_new0 (gboolean, n_pages);
+
 	return EV_JOB (job);
 }
 
+static gboolean
+find_text_extends (const gchar  *text,
+		   const gchar  *previous_text,
+		   EvFindOptions options)
+{
+	gchar   *folded_text;
+	gchar   *folded_previous;
+	gboolean retval;
+
+	if (options & EV_FIND_CASE_SENSITIVE)
+		return strstr (text, previous_text) != NULL;
+
+	folded_text = g_utf8_casefold (text, -1);
+	folded_previous = g_utf8_casefold (previous_text, -1);
+	retval = strstr (folded_text, folded_previous) != NULL;
+	g_free (folded_text);
+	g_free (folded_previous);
+
+	return retval;
+}
+
+/**
+ * ev_job_find_set_previous_job:
+ * @job: an #EvJobFind that hasn't been scheduled yet
+ * @previous: the #EvJobFind of the previous search
+ *
+ * When the search text of @job contains the text of @previous and both
+ * searches use the same options, every match of @job is also a match of
+ * @previous, so @job only needs to search the pages where @previous found
+ * results. Pages that @previous didn't get to search, because it was
+ * cancelled before finishing, are searched as usual. This allows
+ * narrowing the results while the user types without scanning the whole
+ * document on every key stroke.
+ *
+ * Nothing is done when the searches are not compatible, for example when
+ * the search text shrank or whole word matching is used.
+ *
+ * Since: 3.14
+ */
+void
+ev_job_find_set_previous_job (EvJobFind *job,
+			      EvJobFind *previous)
+{
+	EvJobFindPrivate *priv;
+	EvJobFindPrivate *previous_priv;
+	gint              page;
+	gint              i;
+
+	g_return_if_fail (EV_IS_JOB_FIND (job));
+	g_return_if_fail (EV_IS_JOB_FIND (previous));
+
+	if (EV_JOB (previous)->document != EV_JOB (job)->document ||
+	    previous->n_pages != job->n_pages ||
+	    previous->options != job->options ||
+	    (job->options & EV_FIND_WHOLE_WORDS_ONLY) ||
+	    !find_text_extends (job->text, previous->text, job->options))
+		return;
+
+	priv = EV_JOB_FIND_GET_PRIVATE (job);
+	previous_priv = EV_JOB_FIND_GET_PRIVATE (previous);
+
+	if (!priv->candidates)
+		priv->candidates = g_new (gboolean, job->n_pages);
+
+	for (page = 0; page < job->n_pages; page++)
+		priv->candidates[page] = TRUE;
+
+	/* Pages are reported in order, from start_page */
+	for (i = 0; i < previous_priv->n_reported; i++) {
+		page = (previous->start_page + i) % previous->n_pages;
+		priv->candidates[page] = previous->pages[page] != NULL;
+	}
+}
+
 /**
  * ev_job_find_set_options:
  * @job:
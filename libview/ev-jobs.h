@@ -258,11 +258,21 @@ struct _EvJobAnnots
 	EvJob parent;
 
 	GList *annots;
+
+	/* Private */
+	gint current_page;
+	GMutex mutex;
+	GList *pending_annots;
+	guint updated_idle_id;
 };
 
 struct _EvJobAnnotsClass
 {
 	EvJobClass parent_class;
+
+	/* Signals */
+	void (* updated)  (EvJobAnnots *job,
+			   GList       *annots);
 };
 
 struct _EvJobRender
@@ -278,6 +288,9 @@ struct _EvJobRender
 	gint target_height;
 	cairo_surface_t *surface;
 
+	gboolean has_region;
+	cairo_rectangle_int_t region;
+
 	gboolean include_selection;
 	cairo_surface_t *selection;
 	cairo_region_t *selection_region;
@@ -532,6 +545,8 @@ void     ev_job_render_set_selection_info (EvJobRender     *job,
 					   EvSelectionStyle selection_style,
 					   GdkColor        *text,
 					   GdkColor        *base);
+void     ev_job_render_set_region         (EvJobRender           *job,
+					   cairo_rectangle_int_t *region);
 /* EvJobPageData */
 GType           ev_job_page_data_get_type (void) G_GNUC_CONST;
 EvJob          *ev_job_page_data_new      (EvDocument      *document,
@@ -602,6 +617,8 @@ EvJob          *ev_job_find_new           (EvDocument      *document,
 void            ev_job_find_set_options   (EvJobFind       *job,
                                            EvFindOptions    options);
 EvFindOptions   ev_job_find_get_options   (EvJobFind       *job);
+void            ev_job_find_set_previous_job (EvJobFind    *job,
+                                              EvJobFind    *previous);
 gint            ev_job_find_get_n_results (EvJobFind       *job,
 					   gint             pages);
 gdouble         ev_job_find_get_progress  (EvJobFind       *job);
@@ -19,6 +19,7 @@
 
 #include <config.h>
 
+#include <string.h>
 #include <glib.h>
 #include "ev-jobs.h"
 #include "ev-job-scheduler.h"
@@ -48,6 +49,9 @@ typedef struct _EvPageCacheData {
 	PangoAttrList     *text_attrs;
         PangoLogAttr      *text_log_attrs;
         gulong             text_log_attrs_length;
+
+	gsize              size;
+	GList             *lru_link;
 } EvPageCacheData;
 
 struct _EvPageCache {
@@ -61,7 +65,17 @@ struct _EvPageCache {
 	gint               start_page;
 	gint               end_page;
 
+	/* Page of the element focused in the view, its mappings
+	 * can't be freed while the view points to them
+	 */
+	gint               focused_page;
+
 	EvJobPageDataFlags flags;
+
+	/* Pages with data, most recently used first */
+	GQueue             lru;
+	gsize              size;
+	gsize              max_size;
 };
 
 struct _EvPageCacheClass {
@@ -76,6 +90,17 @@ struct _EvPageCacheClass {
 	EV_PAGE_DATA_INCLUDE_ANNOTS)
 
 #define PRE_CACHE_SIZE 1
+/* Pre-caching goes up to this number of pages on one side of the range
+ * when the other side is at the start or end of the document
+ */
+#define PRE_CACHE_MAX_DISTANCE (PRE_CACHE_SIZE * 2)
+#define DEFAULT_MAX_SIZE (32 * 1024 * 1024)
+
+/* Rough estimation of the memory used by a mapping in a list
+ * or by an attribute, including the object it points to
+ */
+#define MAPPING_SIZE   (sizeof (EvMapping) + sizeof (GList) + 64)
+#define TEXT_ATTR_SIZE 64
 
 static void job_page_data_finished_cb (EvJob       *job,
 				       EvPageCache *cache);
@@ -168,6 +193,8 @@ ev_page_cache_finalize (GObject *object)
 		cache->n_pages = 0;
 	}
 
+	g_queue_clear (&cache->lru);
+
 	if (cache->document) {
 		g_object_unref (cache->document);
 		cache->document = NULL;
@@ -179,6 +206,8 @@ ev_page_cache_finalize (GObject *object)
 static void
 ev_page_cache_init (EvPageCache *cache)
 {
+	g_queue_init (&cache->lru);
+	cache->max_size = DEFAULT_MAX_SIZE;
 }
 
 static void
@@ -256,6 +285,106 @@ ev_page_cache_get_flags_for_data (EvPageCache     *cache,
 	return flags;
 }
 
+static gsize
+mapping_list_size (EvMappingList *mapping_list)
+{
+	if (!mapping_list)
+		return 0;
+
+	return g_list_length (ev_mapping_list_get_list (mapping_list)) * MAPPING_SIZE;
+}
+
+static gsize
+ev_page_cache_data_get_size (EvPageCacheData *data)
+{
+	gsize size = 0;
+
+	size += mapping_list_size (data->link_mapping);
+	size += mapping_list_size (data->image_mapping);
+	size += mapping_list_size (data->form_field_mapping);
+	size += mapping_list_size (data->annot_mapping);
+	if (data->text_mapping)
+		size += cairo_region_num_rectangles (data->text_mapping) * sizeof (cairo_rectangle_int_t);
+	if (data->text)
+		size += strlen (data->text);
+	size += data->text_layout_length * sizeof (EvRectangle);
+	size += data->text_log_attrs_length * sizeof (PangoLogAttr);
+	if (data->text_attrs) {
+		PangoAttrIterator *iter;
+
+		iter = pango_attr_list_get_iterator (data->text_attrs);
+		do {
+			GSList *attrs = pango_attr_iterator_get_attrs (iter);
+
+			size += g_slist_length (attrs) * TEXT_ATTR_SIZE;
+			g_slist_free_full (attrs, (GDestroyNotify)pango_attribute_destroy);
+		} while (pango_attr_iterator_next (iter));
+		pango_attr_iterator_destroy (iter);
+	}
+
+	return size;
+}
+
+static void
+ev_page_cache_touch_page (EvPageCache *cache,
+			  gint         page)
+{
+	EvPageCacheData *data = &cache->page_list[page];
+
+	if (data->lru_link) {
+		g_queue_unlink (&cache->lru, data->lru_link);
+		g_queue_push_head_link (&cache->lru, data->lru_link);
+	} else {
+		g_queue_push_head (&cache->lru, GINT_TO_POINTER (page));
+		data->lru_link = cache->lru.head;
+	}
+}
+
+static gboolean
+ev_page_cache_page_is_protected (EvPageCache *cache,
+				 gint         page)
+{
+	EvPageCacheData *data = &cache->page_list[page];
+
+	if (data->job || page == cache->focused_page)
+		return TRUE;
+
+	return page >= cache->start_page - PRE_CACHE_MAX_DISTANCE &&
+		page <= cache->end_page + PRE_CACHE_MAX_DISTANCE;
+}
+
+/* Drops the data of the least recently used pages until the cache
+ * fits in max_size. The pages in the current range, the pre-cached
+ * pages around it and the page of the focused element are never
+ * evicted.
+ */
+static void
+ev_page_cache_evict (EvPageCache *cache)
+{
+	GList *l;
+
+	l = cache->lru.tail;
+	while (l && cache->size > cache->max_size) {
+		GList           *prev = l->prev;
+		gint             page = GPOINTER_TO_INT (l->data);
+		EvPageCacheData *data = &cache->page_list[page];
+
+		if (!ev_page_cache_page_is_protected (cache, page)) {
+			g_queue_delete_link (&cache->lru, l);
+			data->lru_link = NULL;
+			cache->size -= data->size;
+
+			ev_page_cache_data_free (data);
+			data->size = 0;
+			data->flags = EV_PAGE_DATA_INCLUDE_NONE;
+			data->done = FALSE;
+			data->dirty = FALSE;
+		}
+
+		l = prev;
+	}
+}
+
 EvPageCache *
 ev_page_cache_new (EvDocument *document)
 {
@@ -268,6 +397,7 @@ ev_page_cache_new (EvDocument *document)
 	cache->n_pages = ev_document_get_n_pages (document);
 	cache->flags = EV_PAGE_DATA_FLAGS_DEFAULT;
 	cache->page_list = g_new0 (EvPageCacheData, cache->n_pages);
+	cache->focused_page = -1;
 
 	return cache;
 }
@@ -309,6 +439,12 @@ job_page_data_finished_cb (EvJob       *job,
 
 	g_object_unref (data->job);
 	data->job = NULL;
+
+	cache->size -= data->size;
+	data->size = ev_page_cache_data_get_size (data);
+	cache->size += data->size;
+	ev_page_cache_touch_page (cache, job_data->page);
+	ev_page_cache_evict (cache);
 }
 
 static void
@@ -357,14 +493,17 @@ ev_page_cache_set_page_range (EvPageCache *cache,
 	if (cache->flags == EV_PAGE_DATA_INCLUDE_NONE)
 		return;
 
-	for (i = start; i <= end; i++)
-		ev_page_cache_schedule_job_if_needed (cache, i);
-
 	cache->start_page = start;
 	cache->end_page = end;
 
+	for (i = start; i <= end; i++) {
+		ev_page_cache_schedule_job_if_needed (cache, i);
+		if (cache->page_list[i].done)
+			ev_page_cache_touch_page (cache, i);
+	}
+
         i = 1;
-        pages_to_pre_cache = PRE_CACHE_SIZE * 2;
+        pages_to_pre_cache = PRE_CACHE_MAX_DISTANCE;
         while ((start - i > 0) || (end + i < cache->n_pages)) {
                 if (end + i < cache->n_pages) {
                         ev_page_cache_schedule_job_if_needed (cache, end + i);
@@ -381,6 +520,49 @@ ev_page_cache_set_page_range (EvPageCache *cache,
         }
 }
 
+/**
+ * ev_page_cache_set_focused_page:
+ * @cache: a #EvPageCache
+ * @page: the page of the focused element, or -1
+ *
+ * Prevents the data of @page from being evicted while the view keeps
+ * a pointer to one of its mappings.
+ */
+void
+ev_page_cache_set_focused_page (EvPageCache *cache,
+				gint         page)
+{
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+
+	if (cache->focused_page == page)
+		return;
+
+	cache->focused_page = page;
+	ev_page_cache_evict (cache);
+}
+
+/**
+ * ev_page_cache_set_max_size:
+ * @cache: a #EvPageCache
+ * @max_size: size in bytes
+ *
+ * Sets the maximum amount of memory used to keep the data of pages out of
+ * the current range. The data of the pages in the current range is always
+ * kept.
+ */
+void
+ev_page_cache_set_max_size (EvPageCache *cache,
+			    gsize        max_size)
+{
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+
+	if (cache->max_size == max_size)
+		return;
+
+	cache->max_size = max_size;
+	ev_page_cache_evict (cache);
+}
+
 EvJobPageDataFlags
 ev_page_cache_get_flags (EvPageCache *cache)
 {
@@ -663,4 +845,6 @@ ev_page_cache_ensure_page (EvPageCache *cache,
         g_return_if_fail (page >= 0 && page < cache->n_pages);
 
         ev_page_cache_schedule_job_if_needed (cache, page);
+        if (cache->page_list[page].done)
+                ev_page_cache_touch_page (cache, page);
 }
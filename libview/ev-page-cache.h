@@ -47,6 +47,10 @@ EvPageCache       *ev_page_cache_new                    (EvDocument        *docu
 void               ev_page_cache_set_page_range         (EvPageCache       *cache,
 							 gint               start,
 							 gint               end);
+void               ev_page_cache_set_max_size           (EvPageCache       *cache,
+							 gsize              max_size);
+void               ev_page_cache_set_focused_page       (EvPageCache       *cache,
+							 gint               page);
 EvJobPageDataFlags ev_page_cache_get_flags              (EvPageCache       *cache);
 void               ev_page_cache_set_flags              (EvPageCache       *cache,
 							 EvJobPageDataFlags flags);
@@ -19,6 +19,13 @@ typedef struct _CacheJobInfo
 	/* Data we get from rendering */
 	cairo_surface_t *surface;
 
+	/* Set when surface only covers partial_area of the page, at a page
+	 * size of partial_page_width x partial_page_height */
+	gboolean              partial;
+	cairo_rectangle_int_t partial_area;
+	gint                  partial_page_width;
+	gint                  partial_page_height;
+
 	/* Selection data. 
 	 * Selection_points are the coordinates encapsulated in selection.
 	 * target_points is the target selection size. */
@@ -193,6 +200,7 @@ dispose_cache_job_info (CacheJobInfo *job_info,
 	}
 
 	job_info->points_set = FALSE;
+	job_info->partial = FALSE;
 }
 
 static void
@@ -258,6 +266,13 @@ copy_job_to_job_info (EvJobRender   *job_render,
 		ev_document_misc_invert_surface (job_info->surface);
 	}
 
+	job_info->partial = job_render->has_region;
+	if (job_info->partial) {
+		job_info->partial_area = job_render->region;
+		job_info->partial_page_width = job_render->target_width;
+		job_info->partial_page_height = job_render->target_height;
+	}
+
 	job_info->points_set = FALSE;
 	if (job_render->include_selection) {
 		if (job_info->selection) {
@@ -634,16 +649,92 @@ get_selection_colors (EvView *view, GdkColor *text, GdkColor *base)
         base->blue = CLAMP ((guint) (bg.blue * 65535), 0, 65535);
 }
 
+static gboolean
+rectangle_contains (const cairo_rectangle_int_t *rect,
+		    const cairo_rectangle_int_t *other)
+{
+	return other->x >= rect->x && other->y >= rect->y &&
+		other->x + other->width <= rect->x + rect->width &&
+		other->y + other->height <= rect->y + rect->height;
+}
+
+/* Pages that are much larger than the view when zoomed in are rendered
+ * only around their visible part, when the backend supports it. Pages
+ * above or below the view are pre-rendered around the part that will be
+ * shown first when scrolling to them. On success @visible is the part of
+ * the page shown, or to be shown, by the view and @area the part to
+ * render, both in page pixels at the given page size.
+ */
+static gboolean
+get_partial_render_area (EvPixbufCache         *pixbuf_cache,
+			 gint                   page,
+			 gint                   width,
+			 gint                   height,
+			 cairo_rectangle_int_t *visible,
+			 cairo_rectangle_int_t *area)
+{
+	EvView       *view = EV_VIEW (pixbuf_cache->view);
+	GtkAllocation allocation;
+	GdkRectangle  page_area;
+	GdkRectangle  view_area;
+	GdkRectangle  expected_area;
+	GdkRectangle  overlap;
+	GtkBorder     border;
+	gint          margin_x, margin_y;
+
+	if (!ev_document_can_render_region (pixbuf_cache->document))
+		return FALSE;
+
+	gtk_widget_get_allocation (pixbuf_cache->view, &allocation);
+	ev_view_get_page_extents (view, page, &page_area, &border);
+	page_area.x += border.left;
+	page_area.y += border.top;
+	page_area.width = width;
+	page_area.height = height;
+
+	view_area.x = view->scroll_x;
+	view_area.y = view->scroll_y;
+	view_area.width = allocation.width;
+	view_area.height = allocation.height;
+
+	expected_area = view_area;
+	if (page_area.y >= view_area.y + view_area.height)
+		expected_area.y = page_area.y;
+	else if (page_area.y + page_area.height <= view_area.y)
+		expected_area.y = page_area.y + page_area.height - view_area.height;
+
+	if (!gdk_rectangle_intersect (&page_area, &expected_area, &overlap))
+		return FALSE;
+
+	visible->x = overlap.x - page_area.x;
+	visible->y = overlap.y - page_area.y;
+	visible->width = overlap.width;
+	visible->height = overlap.height;
+
+	/* Keep a margin around the visible part so that scrolling a bit
+	 * doesn't need a new render */
+	margin_x = allocation.width / 4;
+	margin_y = allocation.height / 4;
+	area->x = MAX (0, visible->x - margin_x);
+	area->y = MAX (0, visible->y - margin_y);
+	area->width = MIN (width, visible->x + visible->width + margin_x) - area->x;
+	area->height = MIN (height, visible->y + visible->height + margin_y) - area->y;
+
+	/* Only worth it when it saves at least half of the page */
+	return (gint64)area->width * area->height * 2 <= (gint64)width * height;
+}
+
 static void
-add_job (EvPixbufCache  *pixbuf_cache,
-	 CacheJobInfo   *job_info,
-	 cairo_region_t *region,
-	 gint            width,
-	 gint            height,
-	 gint            page,
-	 gint            rotation,
-	 gfloat          scale,
-	 EvJobPriority   priority)
+add_job (EvPixbufCache         *pixbuf_cache,
+	 CacheJobInfo          *job_info,
+	 cairo_region_t        *region,
+	 cairo_rectangle_int_t *render_area,
+	 gint                   width,
+	 gint                   height,
+	 gint                   page,
+	 gint                   rotation,
+	 gfloat                 scale,
+	 EvJobPriority          priority)
 {
 	job_info->page_ready = FALSE;
 
@@ -655,7 +746,11 @@ add_job (EvPixbufCache  *pixbuf_cache,
                                            page, rotation, 0.,
 					   width, height);
 
-	if (new_selection_surface_needed (pixbuf_cache, job_info, page, scale)) {
+	/* The selection is drawn from the selection region for partial
+	 * renders, see ev_pixbuf_cache_get_selection_surface() */
+	if (render_area)
+		ev_job_render_set_region (EV_JOB_RENDER (job_info->job), render_area);
+	else if (new_selection_surface_needed (pixbuf_cache, job_info, page, scale)) {
 		GdkColor text, base;
 
 		get_selection_colors (EV_VIEW (pixbuf_cache->view), &text, &base);
@@ -679,19 +774,45 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		   gfloat         scale,
 		   EvJobPriority  priority)
 {
-	gint width, height;
-
-	if (job_info->job)
-		return;
+	gint                  width, height;
+	cairo_rectangle_int_t visible, area;
+	gboolean              partial;
 
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
 
-	if (job_info->surface &&
-	    cairo_image_surface_get_width (job_info->surface) == width &&
-	    cairo_image_surface_get_height (job_info->surface) == height)
-		return;
+	partial = get_partial_render_area (pixbuf_cache, page, width, height,
+					   &visible, &area);
+
+	if (job_info->job) {
+		EvJobRender *job_render = EV_JOB_RENDER (job_info->job);
+
+		if (!job_render->has_region ||
+		    (partial && rectangle_contains (&job_render->region, &visible)))
+			return;
+
+		/* The view scrolled out of the area being rendered */
+		g_signal_handlers_disconnect_by_func (job_info->job,
+						      G_CALLBACK (job_finished_cb),
+						      pixbuf_cache);
+		ev_job_cancel (job_info->job);
+		g_object_unref (job_info->job);
+		job_info->job = NULL;
+	}
+
+	if (job_info->surface) {
+		if (!job_info->partial) {
+			if (cairo_image_surface_get_width (job_info->surface) == width &&
+			    cairo_image_surface_get_height (job_info->surface) == height)
+				return;
+		} else if (partial &&
+			   job_info->partial_page_width == width &&
+			   job_info->partial_page_height == height &&
+			   rectangle_contains (&job_info->partial_area, &visible)) {
+			return;
+		}
+	}
 
 	/* Free old surfaces for non visible pages */
 	if (priority == EV_JOB_PRIORITY_LOW) {
@@ -706,7 +827,7 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		}
 	}
 
-	add_job (pixbuf_cache, job_info, NULL,
+	add_job (pixbuf_cache, job_info, NULL, partial ? &area : NULL,
 		 width, height, page, rotation, scale,
 		 priority);
 }
@@ -884,6 +1005,30 @@ ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
 	return job_info->surface;
 }
 
+/* Returns TRUE if the surface returned by ev_pixbuf_cache_get_surface()
+ * for @page only covers @area of the page rendered at @page_width x
+ * @page_height, FALSE if it covers the whole page.
+ */
+gboolean
+ev_pixbuf_cache_get_surface_area (EvPixbufCache         *pixbuf_cache,
+				  gint                   page,
+				  cairo_rectangle_int_t *area,
+				  gint                  *page_width,
+				  gint                  *page_height)
+{
+	CacheJobInfo *job_info;
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info == NULL || !job_info->surface || !job_info->partial)
+		return FALSE;
+
+	*area = job_info->partial_area;
+	*page_width = job_info->partial_page_width;
+	*page_height = job_info->partial_page_height;
+
+	return TRUE;
+}
+
 static gboolean
 new_selection_surface_needed (EvPixbufCache *pixbuf_cache,
 			      CacheJobInfo  *job_info,
@@ -1013,6 +1158,12 @@ ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 	if (!job_info->points_set)
 		return NULL;
 
+	/* Rendering the selection of the whole page would defeat the
+	 * partial render, the view uses the selection region instead */
+	if (job_info->partial ||
+	    (job_info->job && EV_JOB_RENDER (job_info->job)->has_region))
+		return NULL;
+
 	/* If we have a running job, we just return what we have under the
 	 * assumption that it'll be updated later and we can scale it as need
 	 * be */
@@ -1323,6 +1474,8 @@ ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 {
 	CacheJobInfo *job_info;
         gint width, height;
+	cairo_rectangle_int_t visible, area;
+	gboolean partial;
 
 	job_info = find_job_cache (pixbuf_cache, page);
 	if (job_info == NULL)
@@ -1331,7 +1484,9 @@ ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
-        add_job (pixbuf_cache, job_info, region,
+	partial = get_partial_render_area (pixbuf_cache, page, width, height,
+					   &visible, &area);
+        add_job (pixbuf_cache, job_info, region, partial ? &area : NULL,
 		 width, height, page, rotation, scale,
 		 EV_JOB_PRIORITY_URGENT);
 }
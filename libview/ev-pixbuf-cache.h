@@ -68,6 +68,11 @@ void           ev_pixbuf_cache_set_page_range       (EvPixbufCache *pixbuf_cache
 						     GList          *selection_list);
 cairo_surface_t *ev_pixbuf_cache_get_surface        (EvPixbufCache *pixbuf_cache,
 						     gint           page);
+gboolean       ev_pixbuf_cache_get_surface_area     (EvPixbufCache         *pixbuf_cache,
+						     gint                   page,
+						     cairo_rectangle_int_t *area,
+						     gint                  *page_width,
+						     gint                  *page_height);
 void           ev_pixbuf_cache_clear                (EvPixbufCache *pixbuf_cache);
 void           ev_pixbuf_cache_style_changed        (EvPixbufCache *pixbuf_cache);
 void           ev_pixbuf_cache_reload_page 	    (EvPixbufCache  *pixbuf_cache,
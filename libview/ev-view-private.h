@@ -101,6 +101,7 @@ typedef enum {
 } PendingScroll;
 
 typedef struct _EvHeightToPageCache {
+	gboolean dirty;
 	gint rotation;
 	gboolean dual_even_left;
 	gdouble *height_to_page;
@@ -127,6 +128,7 @@ struct _EvView {
 	EvPixbufCache *pixbuf_cache;
 	gsize pixbuf_cache_size;
 	EvPageCache *page_cache;
+	gsize page_data_cache_size;
 	EvHeightToPageCache *height_to_page_cache;
 	EvViewCursor cursor;
 	EvJobRender *current_job;
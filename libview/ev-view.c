@@ -103,6 +103,7 @@ typedef struct {
 #define SCROLL_TIME 150
 
 #define DEFAULT_PIXBUF_CACHE_SIZE 52428800 /* 50MB */
+#define DEFAULT_PAGE_DATA_CACHE_SIZE 33554432 /* 32MB */
 
 #define EV_STYLE_CLASS_DOCUMENT_PAGE "document-page"
 #define EV_STYLE_CLASS_INVERTED      "inverted"
@@ -313,6 +314,7 @@ ev_view_build_height_to_page_cache (EvView		*view,
 	g_free (cache->height_to_page);
 	g_free (cache->dual_height_to_page);
 
+	cache->dirty = FALSE;
 	cache->rotation = view->rotation;
 	cache->dual_even_left = view->dual_even_left;
 	cache->height_to_page = g_new0 (gdouble, n_pages + 1);
@@ -434,7 +436,8 @@ ev_view_get_height_to_page (EvView *view,
 		return;
 
 	cache = view->height_to_page_cache;
-	if (cache->rotation != view->rotation ||
+	if (cache->dirty ||
+	    cache->rotation != view->rotation ||
 	    cache->dual_even_left != view->dual_even_left) {
 		ev_view_build_height_to_page_cache (view, cache);
 	}
@@ -2125,6 +2128,8 @@ ev_view_set_focused_element (EvView *view,
 
 	view->focused_element = element_mapping;
 	view->focused_element_page = page;
+	if (view->page_cache)
+		ev_page_cache_set_focused_page (view->page_cache, element_mapping ? page : -1);
 
 	if (ev_view_get_focused_area (view, &view_rect)) {
 		if (!region)
@@ -6120,6 +6125,8 @@ draw_one_page (EvView       *view,
 		cairo_surface_t *selection_surface = NULL;
 		gint offset_x, offset_y;
 		cairo_region_t *region = NULL;
+		cairo_rectangle_int_t area;
+		gint page_width, page_height;
 
 		page_surface = ev_pixbuf_cache_get_surface (view->pixbuf_cache, page);
 
@@ -6136,10 +6143,41 @@ draw_one_page (EvView       *view,
 			ev_view_set_loading (view, FALSE);
 
 		ev_view_get_page_size (view, page, &width, &height);
-		offset_x = overlap.x - real_page_area.x;
-		offset_y = overlap.y - real_page_area.y;
 
-		draw_surface (cr, page_surface, overlap.x, overlap.y, offset_x, offset_y, width, height);
+		if (ev_pixbuf_cache_get_surface_area (view->pixbuf_cache, page,
+						      &area, &page_width, &page_height)) {
+			GdkRectangle surface_area;
+			GdkRectangle draw_area;
+			gdouble      scale_x, scale_y;
+
+			/* The surface only covers part of the page */
+			scale_x = (gdouble)width / page_width;
+			scale_y = (gdouble)height / page_height;
+			surface_area.x = real_page_area.x + area.x * scale_x;
+			surface_area.y = real_page_area.y + area.y * scale_y;
+			surface_area.width = area.width * scale_x;
+			surface_area.height = area.height * scale_y;
+
+			if (gdk_rectangle_intersect (&surface_area, &overlap, &draw_area)) {
+				draw_surface (cr, page_surface, draw_area.x, draw_area.y,
+					      draw_area.x - surface_area.x,
+					      draw_area.y - surface_area.y,
+					      surface_area.width, surface_area.height);
+				if (draw_area.width != overlap.width ||
+				    draw_area.height != overlap.height)
+					*page_ready = FALSE;
+			} else {
+				*page_ready = FALSE;
+			}
+		} else {
+			offset_x = overlap.x - real_page_area.x;
+			offset_y = overlap.y - real_page_area.y;
+
+			draw_surface (cr, page_surface, overlap.x, overlap.y, offset_x, offset_y, width, height);
+
+			page_width = cairo_image_surface_get_width (page_surface);
+			page_height = cairo_image_surface_get_height (page_surface);
+		}
 
 		/* Get the selection pixbuf iff we have something to draw */
 		if (!find_selection_for_page (view, page))
@@ -6149,6 +6187,8 @@ draw_one_page (EvView       *view,
 									   page,
 									   view->scale);
 		if (selection_surface) {
+			offset_x = overlap.x - real_page_area.x;
+			offset_y = overlap.y - real_page_area.y;
 			draw_surface (cr, selection_surface, overlap.x, overlap.y, offset_x, offset_y,
 				      width, height);
 			return;
@@ -6161,8 +6201,8 @@ draw_one_page (EvView       *view,
 			double scale_x, scale_y;
 			GdkRGBA color;
 
-			scale_x = (gdouble)width / cairo_image_surface_get_width (page_surface);
-			scale_y = (gdouble)height / cairo_image_surface_get_height (page_surface);
+			scale_x = (gdouble)width / page_width;
+			scale_y = (gdouble)height / page_height;
 			_ev_view_get_selection_colors (view, &color, NULL);
 			draw_selection_region (cr, region, &color, real_page_area.x, real_page_area.y,
 					       scale_x, scale_y);
@@ -6212,6 +6252,7 @@ ev_view_dispose (GObject *object)
 	}
 
 	if (view->document) {
+		g_signal_handlers_disconnect_by_data (view->document, view);
 		g_object_unref (view->document);
 		view->document = NULL;
 	}
@@ -6757,6 +6798,7 @@ ev_view_init (EvView *view)
 	view->jump_to_find_result = TRUE;
 	view->highlight_find_results = FALSE;
 	view->pixbuf_cache_size = DEFAULT_PIXBUF_CACHE_SIZE;
+	view->page_data_cache_size = DEFAULT_PAGE_DATA_CACHE_SIZE;
 	view->caret_enabled = FALSE;
 	view->cursor_page = 0;
 }
@@ -6885,6 +6927,7 @@ setup_caches (EvView *view)
 	view->height_to_page_cache = ev_view_get_height_to_page_cache (view);
 	view->pixbuf_cache = ev_pixbuf_cache_new (GTK_WIDGET (view), view->model, view->pixbuf_cache_size);
 	view->page_cache = ev_page_cache_new (view->document);
+	ev_page_cache_set_max_size (view->page_cache, view->page_data_cache_size);
 
 	ev_page_cache_set_flags (view->page_cache,
 				 ev_page_cache_get_flags (view->page_cache) |
@@ -6939,6 +6982,72 @@ ev_view_set_page_cache_size (EvView *view,
 	view_update_scale_limits (view);
 }
 
+/**
+ * ev_view_set_page_data_cache_size:
+ * @view: #EvView instance
+ * @cache_size: size in bytes
+ *
+ * Sets the maximum size in bytes that will be used to cache the
+ * links, text and other data of pages that are not visible. The
+ * least recently used pages are dropped when the limit is exceeded,
+ * the visible page range is always kept.
+ *
+ * Since: 3.14
+ */
+void
+ev_view_set_page_data_cache_size (EvView *view,
+				  gsize   cache_size)
+{
+	g_return_if_fail (EV_IS_VIEW (view));
+
+	if (view->page_data_cache_size == cache_size)
+		return;
+
+	view->page_data_cache_size = cache_size;
+	if (view->page_cache)
+		ev_page_cache_set_max_size (view->page_cache, cache_size);
+}
+
+/**
+ * ev_view_get_page_surface:
+ * @view: #EvView instance
+ * @page: the page index
+ *
+ * Gets the surface of @page rendered for the view, if it has been
+ * rendered and not evicted from the view cache yet. The surface is
+ * rendered with the current rotation, at the current scale or a
+ * previous one, and with inverted colors if the document model has
+ * inverted colors set. Pages of which only the visible part has been
+ * rendered have no surface.
+ *
+ * Returns: (transfer none) (allow-none): the rendered surface of @page,
+ *   or %NULL
+ *
+ * Since: 3.14
+ */
+cairo_surface_t *
+ev_view_get_page_surface (EvView *view,
+			  gint    page)
+{
+	cairo_surface_t      *surface;
+	cairo_rectangle_int_t area;
+	gint                  page_width, page_height;
+
+	g_return_val_if_fail (EV_IS_VIEW (view), NULL);
+
+	if (!view->pixbuf_cache)
+		return NULL;
+
+	surface = ev_pixbuf_cache_get_surface (view->pixbuf_cache, page);
+
+	/* Only part of the page has been rendered */
+	if (ev_pixbuf_cache_get_surface_area (view->pixbuf_cache, page,
+					      &area, &page_width, &page_height))
+		return NULL;
+
+	return surface;
+}
+
 /**
  * ev_view_set_loading:
  * @view:
@@ -7005,6 +7114,19 @@ ev_view_autoscroll_stop (EvView *view)
 	ev_view_handle_cursor_over_xy (view, x, y);
 }
 
+static void
+ev_view_page_size_changed_cb (EvDocument *document,
+			      gint        page,
+			      EvView     *view)
+{
+	if (view->height_to_page_cache)
+		view->height_to_page_cache->dirty = TRUE;
+
+	view_update_scale_limits (view);
+	view->pending_scroll = SCROLL_TO_KEEP_POSITION;
+	gtk_widget_queue_resize (GTK_WIDGET (view));
+}
+
 static void
 ev_view_document_changed_cb (EvDocumentModel *model,
 			     GParamSpec      *pspec,
@@ -7019,6 +7141,9 @@ ev_view_document_changed_cb (EvDocumentModel *model,
 		clear_caches (view);
 
 		if (view->document) {
+			g_signal_handlers_disconnect_by_func (view->document,
+							      ev_view_page_size_changed_cb,
+							      view);
 			g_object_unref (view->document);
                 }
 
@@ -7027,6 +7152,10 @@ ev_view_document_changed_cb (EvDocumentModel *model,
 		view->find_result = 0;
 
 		if (view->document) {
+			g_signal_connect (view->document, "page-size-changed",
+					  G_CALLBACK (ev_view_page_size_changed_cb),
+					  view);
+
 			if (ev_document_get_n_pages (view->document) <= 0 ||
 			    !ev_document_check_dimensions (view->document))
 				return;
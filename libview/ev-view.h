@@ -55,6 +55,10 @@ gboolean        ev_view_is_loading          (EvView          *view);
 void            ev_view_reload              (EvView          *view);
 void            ev_view_set_page_cache_size (EvView          *view,
 					     gsize            cache_size);
+void            ev_view_set_page_data_cache_size (EvView     *view,
+						  gsize       cache_size);
+cairo_surface_t *ev_view_get_page_surface   (EvView          *view,
+					     gint             page);
 
 /* Clipboard */
 void		ev_view_copy		  (EvView         *view);
@@ -0,0 +1,439 @@
+/*
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* evince-render: renders page ranges of many documents to PNG files.
+ *
+ * The work is split in two pipelined stages. Backends are not thread
+ * safe, so documents are loaded and their pages rendered one at a time
+ * with the document mutex held, like the viewer does. The rendered
+ * surfaces are handed to a pool of threads that encode and write the
+ * PNG files, while the next pages are rendered.
+ */
+
+#include <config.h>
+
+#include <evince-document.h>
+
+#include <gio/gio.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_DPI 72.0
+
+static gdouble       dpi = DEFAULT_DPI;
+static gint          size = 0;
+static gchar        *pages = NULL;
+static gchar        *output_dir = NULL;
+static gint          n_jobs = 0;
+static gboolean      timings = FALSE;
+static const gchar **file_arguments;
+
+static const GOptionEntry goption_options[] = {
+	{ "pages", 'p', 0, G_OPTION_ARG_STRING, &pages, "Pages to render, e.g. 1-3,7 (all pages by default)", "RANGES" },
+	{ "dpi", 'r', 0, G_OPTION_ARG_DOUBLE, &dpi, "Resolution to render the pages at (72 by default)", "DPI" },
+	{ "size", 's', 0, G_OPTION_ARG_INT, &size, "Render the pages so that their largest side is SIZE pixels, overrides --dpi", "SIZE" },
+	{ "output-dir", 'o', 0, G_OPTION_ARG_FILENAME, &output_dir, "Directory to write the PNG files to (current directory by default)", "DIR" },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &n_jobs, "Number of threads encoding PNG files (number of processors by default)", "N" },
+	{ "timings", 't', 0, G_OPTION_ARG_NONE, &timings, "Print the time spent on every page", NULL },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<input>..." },
+	{ NULL }
+};
+
+typedef struct {
+	gint first;
+	gint last;
+} PageRange;
+
+typedef struct {
+	cairo_surface_t *surface;
+	gchar           *input;
+	gchar           *output;
+	gint             page;
+	gdouble          render_time;
+} EncodeTask;
+
+/* Bounds the number of rendered surfaces waiting to be encoded */
+static GMutex   queue_mutex;
+static GCond    queue_cond;
+static guint    n_queued = 0;
+static guint    max_queued;
+static gboolean failed = FALSE;
+
+static GArray *
+parse_page_ranges (const gchar *ranges,
+		   GError     **error)
+{
+	GArray *array;
+	gchar **items;
+	gint    i;
+
+	array = g_array_new (FALSE, FALSE, sizeof (PageRange));
+	if (!ranges) {
+		PageRange range = { 1, G_MAXINT };
+
+		g_array_append_val (array, range);
+		return array;
+	}
+
+	items = g_strsplit (ranges, ",", -1);
+	for (i = 0; items[i]; i++) {
+		PageRange range;
+		gchar    *dash;
+		gchar    *end;
+
+		g_strstrip (items[i]);
+		if (items[i][0] == '\0')
+			continue;
+
+		dash = strchr (items[i], '-');
+		if (dash) {
+			*dash = '\0';
+			range.first = items[i][0] ? strtol (items[i], &end, 10) : 1;
+			if (items[i][0] && *end != '\0')
+				break;
+			range.last = dash[1] ? strtol (dash + 1, &end, 10) : G_MAXINT;
+			if (dash[1] && *end != '\0')
+				break;
+		} else {
+			range.first = range.last = strtol (items[i], &end, 10);
+			if (*end != '\0')
+				break;
+		}
+
+		if (range.first < 1 || range.last < range.first)
+			break;
+
+		g_array_append_val (array, range);
+	}
+
+	if (items[i]) {
+		g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+			     "Invalid page range: %s", ranges);
+		g_array_free (array, TRUE);
+		array = NULL;
+	}
+	g_strfreev (items);
+
+	return array;
+}
+
+static void
+encode_task_free (EncodeTask *task)
+{
+	cairo_surface_destroy (task->surface);
+	g_free (task->input);
+	g_free (task->output);
+	g_slice_free (EncodeTask, task);
+}
+
+static void
+encode_page (EncodeTask *task,
+	     gpointer    user_data)
+{
+	cairo_status_t status;
+	GTimer        *timer;
+
+	timer = g_timer_new ();
+	status = cairo_surface_write_to_png (task->surface, task->output);
+	g_timer_stop (timer);
+
+	if (status != CAIRO_STATUS_SUCCESS) {
+		g_printerr ("Error writing %s: %s\n", task->output,
+			    cairo_status_to_string (status));
+	} else if (timings) {
+		g_print ("%s\t%d\t%.2f\t%.2f\t%s\n",
+			 task->input, task->page,
+			 task->render_time * 1000,
+			 g_timer_elapsed (timer, NULL) * 1000,
+			 task->output);
+	}
+	g_timer_destroy (timer);
+
+	g_mutex_lock (&queue_mutex);
+	if (status != CAIRO_STATUS_SUCCESS)
+		failed = TRUE;
+	n_queued--;
+	g_cond_signal (&queue_cond);
+	g_mutex_unlock (&queue_mutex);
+
+	encode_task_free (task);
+}
+
+static void
+push_encode_task (GThreadPool *pool,
+		  EncodeTask  *task)
+{
+	g_mutex_lock (&queue_mutex);
+	while (n_queued >= max_queued)
+		g_cond_wait (&queue_cond, &queue_mutex);
+	n_queued++;
+	g_mutex_unlock (&queue_mutex);
+
+	g_thread_pool_push (pool, task, NULL);
+}
+
+/* The extension is kept, so that doc.pdf and doc.djvu don't overwrite
+ * each other's pages. Inputs with the same basename in different
+ * directories are rejected by check_output_names().
+ */
+static gchar *
+get_output_filename (const gchar *input,
+		     gint         page)
+{
+	gchar *basename;
+	gchar *name;
+	gchar *filename;
+
+	basename = g_path_get_basename (input);
+	name = g_strdup_printf ("%s-%d.png", basename, page);
+	filename = g_build_filename (output_dir ? output_dir : ".", name, NULL);
+	g_free (basename);
+	g_free (name);
+
+	return filename;
+}
+
+static gboolean
+check_output_names (const gchar **inputs)
+{
+	GHashTable *names;
+	gboolean    retval = TRUE;
+	gint        i;
+
+	names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (i = 0; inputs[i]; i++) {
+		gchar       *basename = g_path_get_basename (inputs[i]);
+		const gchar *other;
+
+		other = g_hash_table_lookup (names, basename);
+		if (other) {
+			g_printerr ("%s and %s would be rendered to the same files, "
+				    "render them to different output directories\n",
+				    other, inputs[i]);
+			g_free (basename);
+			retval = FALSE;
+			continue;
+		}
+
+		g_hash_table_insert (names, basename, (gpointer)inputs[i]);
+	}
+	g_hash_table_destroy (names);
+
+	return retval;
+}
+
+static EvDocument *
+load_document (const gchar *input)
+{
+	EvDocument *document;
+	GFile      *file;
+	gchar      *uri;
+	GTimer     *timer;
+	GError     *error = NULL;
+
+	file = g_file_new_for_commandline_arg (input);
+	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
+	timer = g_timer_new ();
+	ev_document_fc_mutex_lock ();
+	ev_document_doc_mutex_lock ();
+	document = ev_document_factory_get_document (uri, &error);
+	ev_document_doc_mutex_unlock ();
+	ev_document_fc_mutex_unlock ();
+	g_timer_stop (timer);
+	g_free (uri);
+
+	if (error) {
+		g_printerr ("Error loading %s: %s\n", input, error->message);
+		g_error_free (error);
+		g_clear_object (&document);
+	} else if (timings) {
+		g_print ("%s\tload\t%.2f\n", input,
+			 g_timer_elapsed (timer, NULL) * 1000);
+	}
+	g_timer_destroy (timer);
+
+	return document;
+}
+
+static cairo_surface_t *
+render_page (EvDocument *document,
+	     gint        page_index)
+{
+	EvRenderContext *rc;
+	EvPage          *page;
+	cairo_surface_t *surface;
+	gdouble          width, height;
+	gdouble          scale;
+
+	ev_document_get_page_size (document, page_index, &width, &height);
+	if (size > 0)
+		scale = size / MAX (width, height);
+	else
+		scale = dpi / DEFAULT_DPI;
+
+	page = ev_document_get_page (document, page_index);
+	rc = ev_render_context_new (page, 0, scale);
+	surface = ev_document_render (document, rc);
+	g_object_unref (rc);
+	g_object_unref (page);
+
+	return surface;
+}
+
+static gboolean
+render_document (GThreadPool *pool,
+		 const gchar *input,
+		 GArray      *ranges)
+{
+	EvDocument *document;
+	gint        n_pages;
+	guint       i;
+	gboolean    retval = TRUE;
+
+	document = load_document (input);
+	if (!document)
+		return FALSE;
+
+	n_pages = ev_document_get_n_pages (document);
+
+	for (i = 0; i < ranges->len; i++) {
+		PageRange *range = &g_array_index (ranges, PageRange, i);
+		gint       page;
+
+		/* Open ranges, like the default one, end at the last page */
+		if (range->first > n_pages ||
+		    (range->last != G_MAXINT && range->last > n_pages)) {
+			g_printerr ("Page %d of %s is out of range, the document has %d pages\n",
+				    MAX (range->first, n_pages + 1), input, n_pages);
+			retval = FALSE;
+		}
+
+		for (page = range->first; page <= MIN (range->last, n_pages); page++) {
+			EncodeTask      *task;
+			cairo_surface_t *surface;
+			GTimer          *timer;
+
+			timer = g_timer_new ();
+			ev_document_doc_mutex_lock ();
+			surface = render_page (document, page - 1);
+			ev_document_doc_mutex_unlock ();
+			g_timer_stop (timer);
+
+			if (!surface) {
+				g_printerr ("Error rendering page %d of %s\n", page, input);
+				g_timer_destroy (timer);
+				retval = FALSE;
+				continue;
+			}
+
+			task = g_slice_new (EncodeTask);
+			task->surface = surface;
+			task->input = g_strdup (input);
+			task->output = get_output_filename (input, page);
+			task->page = page;
+			task->render_time = g_timer_elapsed (timer, NULL);
+			g_timer_destroy (timer);
+
+			push_encode_task (pool, task);
+		}
+	}
+
+	g_object_unref (document);
+
+	return retval;
+}
+
+static void
+print_usage (GOptionContext *context)
+{
+	gchar *help;
+
+	help = g_option_context_get_help (context, TRUE, NULL);
+	g_print ("%s", help);
+	g_free (help);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GThreadPool    *pool;
+	GArray         *ranges;
+	GError         *error = NULL;
+	gboolean        success = TRUE;
+	gint            i;
+
+	context = g_option_context_new ("- GNOME Document Batch Renderer");
+	g_option_context_add_main_entries (context, goption_options, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		print_usage (context);
+		g_option_context_free (context);
+
+		return -1;
+	}
+
+	if (!file_arguments) {
+		print_usage (context);
+		g_option_context_free (context);
+
+		return -1;
+	}
+
+	g_option_context_free (context);
+
+	if (dpi <= 0) {
+		g_printerr ("DPI must be a positive number\n");
+		return -1;
+	}
+
+	if (!check_output_names (file_arguments))
+		return -1;
+
+	ranges = parse_page_ranges (pages, &error);
+	if (!ranges) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		return -1;
+	}
+
+	if (n_jobs < 1)
+		n_jobs = g_get_num_processors ();
+	max_queued = n_jobs * 2;
+
+        if (!ev_init ())
+                return -1;
+
+	pool = g_thread_pool_new ((GFunc)encode_page, NULL, n_jobs, TRUE, NULL);
+
+	for (i = 0; file_arguments[i]; i++) {
+		if (!render_document (pool, file_arguments[i], ranges))
+			success = FALSE;
+	}
+
+	/* Wait for all the pages to be written */
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_array_free (ranges, TRUE);
+
+        ev_shutdown ();
+
+	return success && !failed ? 0 : -2;
+}
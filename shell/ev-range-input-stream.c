@@ -0,0 +1,559 @@
+/* ev-range-input-stream.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "ev-range-input-stream.h"
+
+/* Input stream reading a seekable remote file on demand.
+ *
+ * The file is fetched in blocks, that are written at their offset in a
+ * local cache file. Reads only fetch the blocks they touch (plus some
+ * read-ahead), so a backend able to load from a stream, like poppler with
+ * a linearized PDF, can show the first page before the rest of the file
+ * has been transferred. Once all the blocks have been fetched the cache
+ * file is a complete copy of the remote file.
+ *
+ * The remote stream is used by one request at a time, but the mutex is
+ * not held while it's in use: blocks being fetched are marked as such,
+ * and readers needing them wait on the condition instead. Reads from the
+ * backend go ahead of the requests of ev_range_input_stream_fetch_all(),
+ * which are kept small so that they don't delay them for long.
+ */
+
+#define BLOCK_SIZE       65536
+#define READ_AHEAD       4
+#define FETCH_ALL_BLOCKS 4
+
+typedef enum {
+	BLOCK_MISSING,
+	BLOCK_FETCHING,
+	BLOCK_FETCHED
+} BlockState;
+
+struct _EvRangeInputStreamPrivate {
+	GMutex            mutex;
+	GCond             cond;
+
+	GFileInputStream *remote;
+	gboolean          remote_busy;
+	gint              n_pending_reads;
+	goffset           size;
+	gchar            *content_type;
+
+	gint              cache_fd;
+
+	guint             n_blocks;
+	guint             n_blocks_fetched;
+	guint8           *blocks;
+
+	goffset           pos;
+};
+
+#define EV_RANGE_INPUT_STREAM_GET_PRIVATE(object) \
+                (G_TYPE_INSTANCE_GET_PRIVATE ((object), EV_TYPE_RANGE_INPUT_STREAM, EvRangeInputStreamPrivate))
+
+G_DEFINE_TYPE (EvRangeInputStream, ev_range_input_stream, G_TYPE_FILE_INPUT_STREAM)
+
+static void
+ev_range_input_stream_init (EvRangeInputStream *stream)
+{
+	stream->priv = EV_RANGE_INPUT_STREAM_GET_PRIVATE (stream);
+	stream->priv->cache_fd = -1;
+	g_mutex_init (&stream->priv->mutex);
+	g_cond_init (&stream->priv->cond);
+}
+
+static void
+ev_range_input_stream_finalize (GObject *object)
+{
+	EvRangeInputStreamPrivate *priv = EV_RANGE_INPUT_STREAM (object)->priv;
+
+	if (priv->cache_fd != -1)
+		close (priv->cache_fd);
+	g_clear_object (&priv->remote);
+	g_free (priv->content_type);
+	g_free (priv->blocks);
+	g_mutex_clear (&priv->mutex);
+	g_cond_clear (&priv->cond);
+
+	G_OBJECT_CLASS (ev_range_input_stream_parent_class)->finalize (object);
+}
+
+static gboolean
+set_error_from_errno (GError **error)
+{
+	int errsv = errno;
+
+	g_set_error_literal (error, G_IO_ERROR,
+			     g_io_error_from_errno (errsv),
+			     g_strerror (errsv));
+	return FALSE;
+}
+
+static gboolean
+cache_write (EvRangeInputStreamPrivate *priv,
+	     goffset                    offset,
+	     const gchar               *buf,
+	     gsize                      len,
+	     GError                   **error)
+{
+	/* Blocks are written and read from several threads, so the
+	 * file offset is never used
+	 */
+	while (len > 0) {
+		gssize bytes_written;
+
+		bytes_written = pwrite (priv->cache_fd, buf, len, offset);
+		if (bytes_written < 0) {
+			if (errno == EINTR)
+				continue;
+			return set_error_from_errno (error);
+		}
+		buf += bytes_written;
+		offset += bytes_written;
+		len -= bytes_written;
+	}
+
+	return TRUE;
+}
+
+static gssize
+cache_read (EvRangeInputStreamPrivate *priv,
+	    goffset                    offset,
+	    gchar                     *buf,
+	    gsize                      len,
+	    GError                   **error)
+{
+	gsize total = 0;
+
+	while (total < len) {
+		gssize bytes_read;
+
+		bytes_read = pread (priv->cache_fd, buf + total, len - total, offset + total);
+		if (bytes_read < 0) {
+			if (errno == EINTR)
+				continue;
+			set_error_from_errno (error);
+			return -1;
+		}
+		if (bytes_read == 0)
+			break;
+		total += bytes_read;
+	}
+
+	return total;
+}
+
+/* Must be called with the mutex held, which is released while the
+ * blocks are transferred. The blocks must be missing, and the remote
+ * stream must not be busy.
+ */
+static gboolean
+fetch_blocks (EvRangeInputStreamPrivate *priv,
+	      guint                      first_block,
+	      guint                      n_blocks,
+	      GCancellable              *cancellable,
+	      GError                   **error)
+{
+	goffset  offset;
+	gsize    len;
+	gsize    bytes_read;
+	gchar   *buf;
+	gboolean retval = FALSE;
+	guint    i;
+
+	for (i = first_block; i < first_block + n_blocks; i++)
+		priv->blocks[i] = BLOCK_FETCHING;
+	priv->remote_busy = TRUE;
+	g_mutex_unlock (&priv->mutex);
+
+	offset = (goffset)first_block * BLOCK_SIZE;
+	len = MIN ((goffset)n_blocks * BLOCK_SIZE, priv->size - offset);
+	buf = g_malloc (len);
+
+	if (g_seekable_seek (G_SEEKABLE (priv->remote), offset, G_SEEK_SET,
+			     cancellable, error) &&
+	    g_input_stream_read_all (G_INPUT_STREAM (priv->remote), buf, len,
+				     &bytes_read, cancellable, error)) {
+		if (bytes_read != len) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+					     "Remote file is shorter than expected");
+		} else {
+			retval = cache_write (priv, offset, buf, len, error);
+		}
+	}
+	g_free (buf);
+
+	g_mutex_lock (&priv->mutex);
+	priv->remote_busy = FALSE;
+	for (i = first_block; i < first_block + n_blocks; i++)
+		priv->blocks[i] = retval ? BLOCK_FETCHED : BLOCK_MISSING;
+	if (retval)
+		priv->n_blocks_fetched += n_blocks;
+	g_cond_broadcast (&priv->cond);
+
+	return retval;
+}
+
+/* Must be called with the mutex held. Background requests don't use
+ * the remote stream while reads from the backend are waiting for it.
+ */
+static gboolean
+ensure_range (EvRangeInputStreamPrivate *priv,
+	      goffset                    offset,
+	      gsize                      count,
+	      gboolean                   background,
+	      GCancellable              *cancellable,
+	      GError                   **error)
+{
+	guint block, last_block;
+
+	block = offset / BLOCK_SIZE;
+	last_block = (offset + count - 1) / BLOCK_SIZE;
+
+	while (block <= last_block) {
+		guint n_blocks = 0;
+		guint max_blocks;
+
+		if (priv->blocks[block] == BLOCK_FETCHED) {
+			block++;
+			continue;
+		}
+
+		/* Either the block is being fetched by another request,
+		 * and it's missing again if that fails, or the remote
+		 * stream is in use. Check again when that's finished.
+		 */
+		if (priv->blocks[block] == BLOCK_FETCHING || priv->remote_busy ||
+		    (background && priv->n_pending_reads > 0)) {
+			if (g_cancellable_set_error_if_cancelled (cancellable, error))
+				return FALSE;
+			g_cond_wait (&priv->cond, &priv->mutex);
+			continue;
+		}
+
+		/* Fetch the run of missing blocks, reading ahead a bit
+		 * since backends usually keep reading sequentially
+		 */
+		max_blocks = MAX (last_block - block + 1, READ_AHEAD);
+		while (n_blocks < max_blocks &&
+		       block + n_blocks < priv->n_blocks &&
+		       priv->blocks[block + n_blocks] == BLOCK_MISSING)
+			n_blocks++;
+
+		if (!fetch_blocks (priv, block, n_blocks, cancellable, error))
+			return FALSE;
+
+		block += n_blocks;
+	}
+
+	return TRUE;
+}
+
+static gssize
+ev_range_input_stream_read (GInputStream *stream,
+			    void         *buffer,
+			    gsize         count,
+			    GCancellable *cancellable,
+			    GError      **error)
+{
+	EvRangeInputStreamPrivate *priv = EV_RANGE_INPUT_STREAM (stream)->priv;
+	gssize                     bytes_read = 0;
+
+	g_mutex_lock (&priv->mutex);
+
+	if (priv->pos < priv->size && count > 0) {
+		goffset pos = priv->pos;
+		gboolean retval;
+
+		count = MIN ((goffset)count, priv->size - pos);
+
+		/* Keep ev_range_input_stream_fetch_all() from starting
+		 * new requests until the blocks needed here are fetched
+		 */
+		priv->n_pending_reads++;
+		retval = ensure_range (priv, pos, count, FALSE, cancellable, error);
+		priv->n_pending_reads--;
+		g_cond_broadcast (&priv->cond);
+
+		if (retval)
+			bytes_read = cache_read (priv, pos, buffer, count, error);
+		else
+			bytes_read = -1;
+
+		if (bytes_read > 0)
+			priv->pos = pos + bytes_read;
+	}
+
+	g_mutex_unlock (&priv->mutex);
+
+	return bytes_read;
+}
+
+static gssize
+ev_range_input_stream_skip (GInputStream *stream,
+			    gsize         count,
+			    GCancellable *cancellable,
+			    GError      **error)
+{
+	EvRangeInputStreamPrivate *priv = EV_RANGE_INPUT_STREAM (stream)->priv;
+	gssize                     skipped;
+
+	g_mutex_lock (&priv->mutex);
+	skipped = MIN ((goffset)count, MAX (priv->size - priv->pos, 0));
+	priv->pos += skipped;
+	g_mutex_unlock (&priv->mutex);
+
+	return skipped;
+}
+
+static gboolean
+ev_range_input_stream_close (GInputStream *stream,
+			     GCancellable *cancellable,
+			     GError      **error)
+{
+	EvRangeInputStreamPrivate *priv = EV_RANGE_INPUT_STREAM (stream)->priv;
+	gboolean                   retval;
+
+	g_mutex_lock (&priv->mutex);
+	while (priv->remote_busy)
+		g_cond_wait (&priv->cond, &priv->mutex);
+	retval = g_input_stream_close (G_INPUT_STREAM (priv->remote), cancellable, error);
+	g_mutex_unlock (&priv->mutex);
+
+	return retval;
+}
+
+static goffset
+ev_range_input_stream_tell (GFileInputStream *stream)
+{
+	EvRangeInputStreamPrivate *priv = EV_RANGE_INPUT_STREAM (stream)->priv;
+	goffset                    pos;
+
+	g_mutex_lock (&priv->mutex);
+	pos = priv->pos;
+	g_mutex_unlock (&priv->mutex);
+
+	return pos;
+}
+
+static gboolean
+ev_range_input_stream_can_seek (GFileInputStream *stream)
+{
+	return TRUE;
+}
+
+static gboolean
+ev_range_input_stream_seek (GFileInputStream *stream,
+			    goffset           offset,
+			    GSeekType         type,
+			    GCancellable     *cancellable,
+			    GError          **error)
+{
+	EvRangeInputStreamPrivate *priv = EV_RANGE_INPUT_STREAM (stream)->priv;
+	goffset                    pos;
+
+	g_mutex_lock (&priv->mutex);
+
+	switch (type) {
+	case G_SEEK_CUR:
+		pos = priv->pos + offset;
+		break;
+	case G_SEEK_SET:
+		pos = offset;
+		break;
+	case G_SEEK_END:
+		pos = priv->size + offset;
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+
+	if (pos < 0) {
+		g_mutex_unlock (&priv->mutex);
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+				     "Invalid seek request");
+		return FALSE;
+	}
+
+	priv->pos = pos;
+	g_mutex_unlock (&priv->mutex);
+
+	return TRUE;
+}
+
+static GFileInfo *
+ev_range_input_stream_query_info (GFileInputStream *stream,
+				  const char       *attributes,
+				  GCancellable     *cancellable,
+				  GError          **error)
+{
+	EvRangeInputStreamPrivate *priv = EV_RANGE_INPUT_STREAM (stream)->priv;
+	GFileInfo                 *info;
+
+	info = g_file_info_new ();
+	g_file_info_set_size (info, priv->size);
+	if (priv->content_type)
+		g_file_info_set_content_type (info, priv->content_type);
+
+	return info;
+}
+
+static void
+ev_range_input_stream_class_init (EvRangeInputStreamClass *klass)
+{
+	GObjectClass          *object_class = G_OBJECT_CLASS (klass);
+	GInputStreamClass     *stream_class = G_INPUT_STREAM_CLASS (klass);
+	GFileInputStreamClass *file_stream_class = G_FILE_INPUT_STREAM_CLASS (klass);
+
+	object_class->finalize = ev_range_input_stream_finalize;
+
+	stream_class->read_fn = ev_range_input_stream_read;
+	stream_class->skip = ev_range_input_stream_skip;
+	stream_class->close_fn = ev_range_input_stream_close;
+
+	file_stream_class->tell = ev_range_input_stream_tell;
+	file_stream_class->can_seek = ev_range_input_stream_can_seek;
+	file_stream_class->seek = ev_range_input_stream_seek;
+	file_stream_class->query_info = ev_range_input_stream_query_info;
+
+	g_type_class_add_private (object_class, sizeof (EvRangeInputStreamPrivate));
+}
+
+/**
+ * ev_range_input_stream_new:
+ * @remote: a seekable #GFileInputStream
+ * @size: the size of the remote file
+ * @content_type: (allow-none): the content type of the remote file
+ * @cache_uri: the URI of a local file where fetched data is stored
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Returns: a new #GInputStream reading @remote on demand, or %NULL
+ *   on error
+ */
+GInputStream *
+ev_range_input_stream_new (GFileInputStream *remote,
+			   goffset           size,
+			   const gchar      *content_type,
+			   const gchar      *cache_uri,
+			   GError          **error)
+{
+	EvRangeInputStream *stream;
+	gchar              *filename;
+	gint                fd;
+
+	g_return_val_if_fail (G_IS_FILE_INPUT_STREAM (remote), NULL);
+	g_return_val_if_fail (g_seekable_can_seek (G_SEEKABLE (remote)), NULL);
+	g_return_val_if_fail (size > 0, NULL);
+
+	filename = g_filename_from_uri (cache_uri, NULL, error);
+	if (!filename)
+		return NULL;
+
+	fd = g_open (filename, O_RDWR | O_CREAT, 0600);
+	g_free (filename);
+	if (fd == -1) {
+		set_error_from_errno (error);
+		return NULL;
+	}
+
+	stream = g_object_new (EV_TYPE_RANGE_INPUT_STREAM, NULL);
+	stream->priv->remote = g_object_ref (remote);
+	stream->priv->size = size;
+	stream->priv->content_type = g_strdup (content_type);
+	stream->priv->cache_fd = fd;
+	stream->priv->n_blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	stream->priv->blocks = g_new0 (guint8, stream->priv->n_blocks);
+
+	return G_INPUT_STREAM (stream);
+}
+
+/**
+ * ev_range_input_stream_fetch_all:
+ * @stream: a #EvRangeInputStream
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Fetches all the blocks that haven't been read yet, so that the cache
+ * file becomes a complete copy of the remote file. This blocks, it's
+ * meant to be run in a thread. Reads from the backend waiting for the
+ * remote file are always served before the next block is fetched here.
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ */
+gboolean
+ev_range_input_stream_fetch_all (EvRangeInputStream *stream,
+				 GCancellable       *cancellable,
+				 GError            **error)
+{
+	EvRangeInputStreamPrivate *priv;
+	guint                      block;
+
+	g_return_val_if_fail (EV_IS_RANGE_INPUT_STREAM (stream), FALSE);
+
+	priv = stream->priv;
+
+	for (block = 0; block < priv->n_blocks; block += FETCH_ALL_BLOCKS) {
+		gboolean retval;
+		guint    n_blocks;
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error))
+			return FALSE;
+
+		n_blocks = MIN (FETCH_ALL_BLOCKS, priv->n_blocks - block);
+
+		g_mutex_lock (&priv->mutex);
+		retval = ensure_range (priv, (goffset)block * BLOCK_SIZE,
+				       MIN ((goffset)n_blocks * BLOCK_SIZE,
+					    priv->size - (goffset)block * BLOCK_SIZE),
+				       TRUE, cancellable, error);
+		g_mutex_unlock (&priv->mutex);
+
+		if (!retval)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * ev_range_input_stream_is_complete:
+ * @stream: a #EvRangeInputStream
+ *
+ * Returns: whether the whole remote file has been fetched
+ */
+gboolean
+ev_range_input_stream_is_complete (EvRangeInputStream *stream)
+{
+	gboolean retval;
+
+	g_return_val_if_fail (EV_IS_RANGE_INPUT_STREAM (stream), FALSE);
+
+	g_mutex_lock (&stream->priv->mutex);
+	retval = stream->priv->n_blocks_fetched == stream->priv->n_blocks;
+	g_mutex_unlock (&stream->priv->mutex);
+
+	return retval;
+}
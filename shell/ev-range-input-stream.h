@@ -0,0 +1,60 @@
+/* ev-range-input-stream.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef EV_RANGE_INPUT_STREAM_H
+#define EV_RANGE_INPUT_STREAM_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EvRangeInputStream        EvRangeInputStream;
+typedef struct _EvRangeInputStreamClass   EvRangeInputStreamClass;
+typedef struct _EvRangeInputStreamPrivate EvRangeInputStreamPrivate;
+
+#define EV_TYPE_RANGE_INPUT_STREAM              (ev_range_input_stream_get_type())
+#define EV_RANGE_INPUT_STREAM(object)           (G_TYPE_CHECK_INSTANCE_CAST((object), EV_TYPE_RANGE_INPUT_STREAM, EvRangeInputStream))
+#define EV_RANGE_INPUT_STREAM_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_RANGE_INPUT_STREAM, EvRangeInputStreamClass))
+#define EV_IS_RANGE_INPUT_STREAM(object)        (G_TYPE_CHECK_INSTANCE_TYPE((object), EV_TYPE_RANGE_INPUT_STREAM))
+#define EV_IS_RANGE_INPUT_STREAM_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE((klass), EV_TYPE_RANGE_INPUT_STREAM))
+#define EV_RANGE_INPUT_STREAM_GET_CLASS(object) (G_TYPE_INSTANCE_GET_CLASS((object), EV_TYPE_RANGE_INPUT_STREAM, EvRangeInputStreamClass))
+
+struct _EvRangeInputStream {
+	GFileInputStream base_instance;
+
+	EvRangeInputStreamPrivate *priv;
+};
+
+struct _EvRangeInputStreamClass {
+	GFileInputStreamClass base_class;
+};
+
+GType         ev_range_input_stream_get_type    (void) G_GNUC_CONST;
+GInputStream *ev_range_input_stream_new         (GFileInputStream   *remote,
+						 goffset             size,
+						 const gchar        *content_type,
+						 const gchar        *cache_uri,
+						 GError            **error);
+gboolean      ev_range_input_stream_fetch_all   (EvRangeInputStream *stream,
+						 GCancellable       *cancellable,
+						 GError            **error);
+gboolean      ev_range_input_stream_is_complete (EvRangeInputStream *stream);
+
+G_END_DECLS
+
+#endif /* EV_RANGE_INPUT_STREAM_H */
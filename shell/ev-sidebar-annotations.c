@@ -56,8 +56,9 @@ struct _EvSidebarAnnotationsPrivate {
 	GtkWidget   *palette;
 	GtkToolItem *annot_text_item;
 
-	EvJob       *job;
-	guint        selection_changed_id;
+	EvJob        *job;
+	GtkTreeStore *model;
+	guint         selection_changed_id;
 };
 
 static void ev_sidebar_annotations_page_iface_init (EvSidebarPageInterface *iface);
@@ -86,6 +87,8 @@ ev_sidebar_annotations_dispose (GObject *object)
 		priv->document = NULL;
 	}
 
+	g_clear_object (&priv->model);
+
 	G_OBJECT_CLASS (ev_sidebar_annotations_parent_class)->dispose (object);
 }
 
@@ -344,11 +347,11 @@ selection_changed_cb (GtkTreeSelection     *selection,
 }
 
 static void
-job_finished_callback (EvJobAnnots          *job,
-		       EvSidebarAnnotations *sidebar_annots)
+job_updated_callback (EvJobAnnots          *job,
+		      GList                *annots,
+		      EvSidebarAnnotations *sidebar_annots)
 {
 	EvSidebarAnnotationsPrivate *priv;
-	GtkTreeStore *model;
 	GtkTreeSelection *selection;
 	GList *l;
 	GdkPixbuf *text_icon = NULL;
@@ -356,34 +359,25 @@ job_finished_callback (EvJobAnnots          *job,
 
 	priv = sidebar_annots->priv;
 
-	if (!job->annots) {
-		GtkTreeModel *list;
-
-		list = ev_sidebar_annotations_create_simple_model (_("Document contains no annotations"));
-		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view), list);
-		g_object_unref (list);
-
-		g_object_unref (job);
-		priv->job = NULL;
-
-		return;
-	}
+	if (!priv->model) {
+		selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
+		gtk_tree_selection_set_mode (selection, GTK_SELECTION_SINGLE);
+		if (priv->selection_changed_id == 0) {
+			priv->selection_changed_id =
+				g_signal_connect (selection, "changed",
+						  G_CALLBACK (selection_changed_cb),
+						  sidebar_annots);
+		}
 
-	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
-	gtk_tree_selection_set_mode (selection, GTK_SELECTION_SINGLE);
-	if (priv->selection_changed_id == 0) {
-		priv->selection_changed_id =
-			g_signal_connect (selection, "changed",
-					  G_CALLBACK (selection_changed_cb),
-					  sidebar_annots);
+		priv->model = gtk_tree_store_new (N_COLUMNS,
+						  G_TYPE_STRING,
+						  GDK_TYPE_PIXBUF,
+						  G_TYPE_POINTER);
+		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view),
+					 GTK_TREE_MODEL (priv->model));
 	}
 
-	model = gtk_tree_store_new (N_COLUMNS,
-				    G_TYPE_STRING,
-				    GDK_TYPE_PIXBUF,
-				    G_TYPE_POINTER);
-
-	for (l = job->annots; l; l = g_list_next (l)) {
+	for (l = annots; l; l = g_list_next (l)) {
 		EvMappingList *mapping_list;
 		GList         *ll;
 		gchar         *page_label;
@@ -393,8 +387,8 @@ job_finished_callback (EvJobAnnots          *job,
 		mapping_list = (EvMappingList *)l->data;
 		page_label = g_strdup_printf (_("Page %d"),
 					      ev_mapping_list_get_page (mapping_list) + 1);
-		gtk_tree_store_append (model, &iter, NULL);
-		gtk_tree_store_set (model, &iter,
+		gtk_tree_store_append (priv->model, &iter, NULL);
+		gtk_tree_store_set (priv->model, &iter,
 				    COLUMN_MARKUP, page_label,
 				    -1);
 		g_free (page_label);
@@ -437,8 +431,8 @@ job_finished_callback (EvJobAnnots          *job,
 				pixbuf = attachment_icon;
 			}
 
-			gtk_tree_store_append (model, &child_iter, &iter);
-			gtk_tree_store_set (model, &child_iter,
+			gtk_tree_store_append (priv->model, &child_iter, &iter);
+			gtk_tree_store_set (priv->model, &child_iter,
 					    COLUMN_MARKUP, markup,
 					    COLUMN_ICON, pixbuf,
 					    COLUMN_ANNOT_MAPPING, ll->data,
@@ -448,17 +442,33 @@ job_finished_callback (EvJobAnnots          *job,
 		}
 
 		if (!found)
-			gtk_tree_store_remove (model, &iter);
+			gtk_tree_store_remove (priv->model, &iter);
 	}
 
-	gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view),
-				 GTK_TREE_MODEL (model));
-	g_object_unref (model);
-
 	if (text_icon)
 		g_object_unref (text_icon);
 	if (attachment_icon)
 		g_object_unref (attachment_icon);
+}
+
+static void
+job_finished_callback (EvJobAnnots          *job,
+		       EvSidebarAnnotations *sidebar_annots)
+{
+	EvSidebarAnnotationsPrivate *priv;
+
+	priv = sidebar_annots->priv;
+
+	/* Annotations have already been added to the model
+	 * while the job was running, see job_updated_callback()
+	 */
+	if (!job->annots) {
+		GtkTreeModel *list;
+
+		list = ev_sidebar_annotations_create_simple_model (_("Document contains no annotations"));
+		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view), list);
+		g_object_unref (list);
+	}
 
 	g_object_unref (job);
 	priv->job = NULL;
@@ -473,10 +483,20 @@ ev_sidebar_annotations_load (EvSidebarAnnotations *sidebar_annots)
 		g_signal_handlers_disconnect_by_func (priv->job,
 						      job_finished_callback,
 						      sidebar_annots);
+		g_signal_handlers_disconnect_by_func (priv->job,
+						      job_updated_callback,
+						      sidebar_annots);
+		ev_job_cancel (priv->job);
 		g_object_unref (priv->job);
 	}
 
+	/* A new model is created when the first annotations are found */
+	g_clear_object (&priv->model);
+
 	priv->job = ev_job_annots_new (priv->document);
+	g_signal_connect (priv->job, "updated",
+			  G_CALLBACK (job_updated_callback),
+			  sidebar_annots);
 	g_signal_connect (priv->job, "finished",
 			  G_CALLBACK (job_finished_callback),
 			  sidebar_annots);
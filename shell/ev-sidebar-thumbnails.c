@@ -37,6 +37,8 @@
 #include "ev-job-scheduler.h"
 #include "ev-sidebar-page.h"
 #include "ev-sidebar-thumbnails.h"
+#include "ev-thumbnail-cache.h"
+#include "ev-thumbnails-model.h"
 #include "ev-utils.h"
 #include "ev-window.h"
 
@@ -52,7 +54,9 @@ typedef struct _EvThumbsSize
 	gint height;
 } EvThumbsSize;
 
+/* Sizes of non uniform documents are computed the first time a page is shown */
 typedef struct _EvThumbsSizeCache {
+	EvDocument *document;
 	gboolean uniform;
 	gint uniform_width;
 	gint uniform_height;
@@ -64,11 +68,15 @@ struct _EvSidebarThumbnailsPrivate {
 	GtkWidget *icon_view;
 	GtkWidget *tree_view;
 	GtkAdjustment *vadjustment;
-	GtkListStore *list_store;
+	EvThumbnailsModel *thumbnails_model;
+	GHashTable *jobs;
+	GHashTable *cache_lookups;
 	GHashTable *loading_icons;
 	EvDocument *document;
 	EvDocumentModel *model;
+	EvView *view;
 	EvThumbsSizeCache *size_cache;
+	EvThumbnailCache *thumbnail_cache;
         gint width;
 
 	gint n_pages, pages_done;
@@ -80,14 +88,6 @@ struct _EvSidebarThumbnailsPrivate {
 	gint start_page, end_page;
 };
 
-enum {
-	COLUMN_PAGE_STRING,
-	COLUMN_SURFACE,
-	COLUMN_THUMBNAIL_SET,
-	COLUMN_JOB,
-	NUM_COLUMNS
-};
-
 enum {
 	PROP_0,
 	PROP_WIDGET,
@@ -103,6 +103,9 @@ static void         ev_sidebar_thumbnails_set_current_page (EvSidebarThumbnails
 static void         thumbnail_job_completed_callback       (EvJobThumbnail          *job,
 							    EvSidebarThumbnails     *sidebar_thumbnails);
 static void         adjustment_changed_cb                  (EvSidebarThumbnails     *sidebar_thumbnails);
+static void         ev_sidebar_thumbnails_set_thumbnail    (EvSidebarThumbnails     *sidebar_thumbnails,
+							    gint                     page,
+							    cairo_surface_t         *thumbnail);
 
 G_DEFINE_TYPE_EXTENDED (EvSidebarThumbnails, 
                         ev_sidebar_thumbnails, 
@@ -137,10 +140,9 @@ static EvThumbsSizeCache *
 ev_thumbnails_size_cache_new (EvDocument *document)
 {
 	EvThumbsSizeCache *cache;
-	gint               i, n_pages;
-	EvThumbsSize      *thumb_size;
 
 	cache = g_new0 (EvThumbsSizeCache, 1);
+	cache->document = document;
 
 	if (ev_document_is_page_size_uniform (document)) {
 		cache->uniform = TRUE;
@@ -150,15 +152,7 @@ ev_thumbnails_size_cache_new (EvDocument *document)
 		return cache;
 	}
 
-	n_pages = ev_document_get_n_pages (document);
-	cache->sizes = g_new0 (EvThumbsSize, n_pages);
-
-	for (i = 0; i < n_pages; i++) {
-		thumb_size = &(cache->sizes[i]);
-		get_thumbnail_size_for_page (document, i,
-					     &thumb_size->width,
-					     &thumb_size->height);
-	}
+	cache->sizes = g_new0 (EvThumbsSize, ev_document_get_n_pages (document));
 
 	return cache;
 }
@@ -179,6 +173,11 @@ ev_thumbnails_size_cache_get_size (EvThumbsSizeCache *cache,
 		EvThumbsSize *thumb_size;
 
 		thumb_size = &(cache->sizes[page]);
+		if (thumb_size->width == 0) {
+			get_thumbnail_size_for_page (cache->document, page,
+						     &thumb_size->width,
+						     &thumb_size->height);
+		}
 
 		w = thumb_size->width;
 		h = thumb_size->height;
@@ -237,7 +236,7 @@ ev_sidebar_thumbnails_page_is_in_visible_range (EvSidebarThumbnails *sidebar,
                 if (!gtk_tree_selection_get_selected (selection, NULL, &iter))
                         return FALSE;
 
-                path = gtk_tree_model_get_path (GTK_TREE_MODEL (sidebar->priv->list_store), &iter);
+                path = gtk_tree_model_get_path (GTK_TREE_MODEL (sidebar->priv->thumbnails_model), &iter);
                 if (!gtk_tree_view_get_visible_range (GTK_TREE_VIEW (sidebar->priv->tree_view), &start, &end)) {
                         gtk_tree_path_free (path);
                         return FALSE;
@@ -274,10 +273,26 @@ ev_sidebar_thumbnails_dispose (GObject *object)
 		sidebar_thumbnails->priv->loading_icons = NULL;
 	}
 	
-	if (sidebar_thumbnails->priv->list_store) {
+	if (sidebar_thumbnails->priv->view) {
+		g_object_remove_weak_pointer (G_OBJECT (sidebar_thumbnails->priv->view),
+					      (gpointer *)&sidebar_thumbnails->priv->view);
+		sidebar_thumbnails->priv->view = NULL;
+	}
+
+	if (sidebar_thumbnails->priv->thumbnails_model) {
 		ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
-		g_object_unref (sidebar_thumbnails->priv->list_store);
-		sidebar_thumbnails->priv->list_store = NULL;
+		g_object_unref (sidebar_thumbnails->priv->thumbnails_model);
+		sidebar_thumbnails->priv->thumbnails_model = NULL;
+	}
+
+	if (sidebar_thumbnails->priv->jobs) {
+		g_hash_table_destroy (sidebar_thumbnails->priv->jobs);
+		sidebar_thumbnails->priv->jobs = NULL;
+	}
+
+	if (sidebar_thumbnails->priv->cache_lookups) {
+		g_hash_table_destroy (sidebar_thumbnails->priv->cache_lookups);
+		sidebar_thumbnails->priv->cache_lookups = NULL;
 	}
 
 	G_OBJECT_CLASS (ev_sidebar_thumbnails_parent_class)->dispose (object);
@@ -373,6 +388,34 @@ ev_sidebar_thumbnails_new (void)
 	return ev_sidebar_thumbnails;
 }
 
+/**
+ * ev_sidebar_thumbnails_set_view:
+ * @sidebar_thumbnails: an #EvSidebarThumbnails
+ * @view: the #EvView showing the same document model
+ *
+ * Pages already rendered by @view are downsampled into thumbnails
+ * instead of being rendered again by the backend.
+ */
+void
+ev_sidebar_thumbnails_set_view (EvSidebarThumbnails *sidebar_thumbnails,
+				EvView              *view)
+{
+	EvSidebarThumbnailsPrivate *priv;
+
+	g_return_if_fail (EV_IS_SIDEBAR_THUMBNAILS (sidebar_thumbnails));
+	g_return_if_fail (view == NULL || EV_IS_VIEW (view));
+
+	priv = sidebar_thumbnails->priv;
+	if (priv->view == view)
+		return;
+
+	if (priv->view)
+		g_object_remove_weak_pointer (G_OBJECT (priv->view), (gpointer *)&priv->view);
+	priv->view = view;
+	if (priv->view)
+		g_object_add_weak_pointer (G_OBJECT (priv->view), (gpointer *)&priv->view);
+}
+
 static cairo_surface_t *
 ev_sidebar_thumbnails_get_loading_icon (EvSidebarThumbnails *sidebar_thumbnails,
 					gint                 width,
@@ -399,58 +442,160 @@ ev_sidebar_thumbnails_get_loading_icon (EvSidebarThumbnails *sidebar_thumbnails,
 	return icon;
 }
 
+static cairo_surface_t *
+ev_sidebar_thumbnails_get_loading_icon_for_page (gint                 page,
+						 EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	gint width, height;
+
+	ev_thumbnails_size_cache_get_size (priv->size_cache, page,
+					   priv->rotation,
+					   &width, &height);
+
+	return ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails, width, height);
+}
+
+static void
+ev_sidebar_thumbnails_cancel_job (EvSidebarThumbnails *sidebar_thumbnails,
+				  EvJob               *job)
+{
+	g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, sidebar_thumbnails);
+	ev_job_cancel (job);
+}
+
+/* Averages every pixel of @source into the destination pixel it falls in.
+ * Channels are premultiplied, so they can be averaged independently */
+static cairo_surface_t *
+box_filter_surface (cairo_surface_t *source,
+		    gint             width,
+		    gint             height)
+{
+	cairo_surface_t *surface;
+	cairo_format_t   format;
+	const guchar    *src;
+	guchar          *dst;
+	gint             src_stride, dst_stride;
+	gint             src_width, src_height;
+	gint            *x_bounds;
+	gint             x, y;
+
+	format = cairo_image_surface_get_format (source);
+	if (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24)
+		return NULL;
+
+	src_width = cairo_image_surface_get_width (source);
+	src_height = cairo_image_surface_get_height (source);
+	if (src_width < width || src_height < height)
+		return NULL;
+
+	surface = cairo_image_surface_create (format, width, height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (surface);
+		return NULL;
+	}
+
+	cairo_surface_flush (source);
+	src = cairo_image_surface_get_data (source);
+	src_stride = cairo_image_surface_get_stride (source);
+	dst = cairo_image_surface_get_data (surface);
+	dst_stride = cairo_image_surface_get_stride (surface);
+
+	x_bounds = g_new (gint, width + 1);
+	for (x = 0; x <= width; x++)
+		x_bounds[x] = (gint64)x * src_width / width;
+
+	for (y = 0; y < height; y++) {
+		gint y0 = (gint64)y * src_height / height;
+		gint y1 = (gint64)(y + 1) * src_height / height;
+
+		for (x = 0; x < width; x++) {
+			guint32 sum[4] = { 0, 0, 0, 0 };
+			guint32 n_pixels;
+			guchar *p;
+			gint    sx, sy, i;
+
+			for (sy = y0; sy < y1; sy++) {
+				const guchar *s = src + sy * src_stride + x_bounds[x] * 4;
+
+				for (sx = x_bounds[x]; sx < x_bounds[x + 1]; sx++, s += 4) {
+					sum[0] += s[0];
+					sum[1] += s[1];
+					sum[2] += s[2];
+					sum[3] += s[3];
+				}
+			}
+
+			n_pixels = (y1 - y0) * (x_bounds[x + 1] - x_bounds[x]);
+			p = dst + y * dst_stride + x * 4;
+			for (i = 0; i < 4; i++)
+				p[i] = (sum[i] + n_pixels / 2) / n_pixels;
+		}
+	}
+	g_free (x_bounds);
+
+	cairo_surface_mark_dirty (surface);
+
+	return surface;
+}
+
+/* Returns a new reference to the surface rendered by the view for @page,
+ * or %NULL if the view hasn't rendered the page at a size larger than
+ * the thumbnail */
+static cairo_surface_t *
+ev_sidebar_thumbnails_get_view_surface (EvSidebarThumbnails *sidebar_thumbnails,
+					gint                 page,
+					gint                 width,
+					gint                 height)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	cairo_surface_t *source;
+	gdouble source_ratio;
+
+	if (!priv->view)
+		return NULL;
+
+	source = ev_view_get_page_surface (priv->view, page);
+	if (!source || cairo_surface_get_type (source) != CAIRO_SURFACE_TYPE_IMAGE)
+		return NULL;
+
+	/* Don't use surfaces rendered for a different page size or rotation */
+	source_ratio = (gdouble)cairo_image_surface_get_width (source) /
+		cairo_image_surface_get_height (source);
+	if (ABS (source_ratio - (gdouble)width / height) > 0.02 * source_ratio)
+		return NULL;
+
+	if (cairo_image_surface_get_width (source) < width ||
+	    cairo_image_surface_get_height (source) < height)
+		return NULL;
+
+	return cairo_surface_reference (source);
+}
+
+/* Thumbnails already rendered are kept by the model, which evicts them
+ * when they are no longer visible and too many have been rendered */
 static void
 clear_range (EvSidebarThumbnails *sidebar_thumbnails,
 	     gint                 start_page,
 	     gint                 end_page)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreePath *path;
-	GtkTreeIter iter;
-	gboolean result;
-	gint prev_width = -1;
-	gint prev_height = -1;
+	gint page;
 
 	g_assert (start_page <= end_page);
 
-	path = gtk_tree_path_new_from_indices (start_page, -1);
-	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
-	     result && start_page <= end_page;
-	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), start_page ++) {
-		EvJobThumbnail *job;
-		cairo_surface_t *loading_icon = NULL;
-		gint width, height;
-
-		gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store),
-				    &iter,
-				    COLUMN_JOB, &job,
-				    -1);
-
-		if (job) {
-			g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, sidebar_thumbnails);
-			ev_job_cancel (EV_JOB (job));
-			g_object_unref (job);
-		}
+	for (page = start_page; page <= end_page; page++) {
+		EvJob *job;
 
-		ev_thumbnails_size_cache_get_size (priv->size_cache, start_page,
-						  priv->rotation,
-						  &width, &height);
-		if (!loading_icon || (width != prev_width && height != prev_height)) {
-			loading_icon =
-				ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails,
-									width, height);
-		}
+		g_hash_table_remove (priv->cache_lookups, GINT_TO_POINTER (page));
 
-		prev_width = width;
-		prev_height = height;
+		job = g_hash_table_lookup (priv->jobs, GINT_TO_POINTER (page));
+		if (!job)
+			continue;
 
-		gtk_list_store_set (priv->list_store, &iter,
-				    COLUMN_JOB, NULL,
-				    COLUMN_THUMBNAIL_SET, FALSE,
-				    COLUMN_SURFACE, loading_icon,
-				    -1);
+		ev_sidebar_thumbnails_cancel_job (sidebar_thumbnails, job);
+		g_hash_table_remove (priv->jobs, GINT_TO_POINTER (page));
 	}
-	gtk_tree_path_free (path);
 }
 
 static void
@@ -475,58 +620,220 @@ get_size_for_page (EvSidebarThumbnails *sidebar_thumbnails,
         }
 }
 
+typedef struct {
+	EvSidebarThumbnails *sidebar_thumbnails;
+	gint                 page;
+	gint                 width;
+	gint                 height;
+} ThumbnailLookupData;
+
+static void
+cancel_and_unref (GCancellable *cancellable)
+{
+	g_cancellable_cancel (cancellable);
+	g_object_unref (cancellable);
+}
+
+static void
+render_thumbnail_job (EvSidebarThumbnails *sidebar_thumbnails,
+		      gint                 page,
+		      gint                 thumbnail_width,
+		      gint                 thumbnail_height)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	EvJob *job;
+
+	job = ev_job_thumbnail_new_with_target_size (priv->document,
+						     page, priv->rotation,
+						     thumbnail_width, thumbnail_height);
+	ev_job_thumbnail_set_has_frame (EV_JOB_THUMBNAIL (job), FALSE);
+	ev_job_thumbnail_set_output_format (EV_JOB_THUMBNAIL (job), EV_JOB_THUMBNAIL_SURFACE);
+	g_signal_connect (job, "finished",
+			  G_CALLBACK (thumbnail_job_completed_callback),
+			  sidebar_thumbnails);
+	/* The queue and the jobs table own a ref to the job */
+	g_hash_table_insert (priv->jobs, GINT_TO_POINTER (page), job);
+	ev_job_scheduler_push_job (EV_JOB (job), EV_JOB_PRIORITY_HIGH);
+}
+
+typedef struct {
+	cairo_surface_t *source;
+	gint             width;
+	gint             height;
+	gboolean         inverted_colors;
+} DownsampleData;
+
+static void
+downsample_data_free (DownsampleData *data)
+{
+	cairo_surface_destroy (data->source);
+	g_slice_free (DownsampleData, data);
+}
+
+/* Returns the thumbnail without inverted colors, the view surface
+ * has them inverted when the view does */
+static void
+downsample_thread (GTask          *task,
+		   gpointer        source_object,
+		   DownsampleData *data,
+		   GCancellable   *cancellable)
+{
+	cairo_surface_t *thumbnail;
+
+	if (g_task_return_error_if_cancelled (task))
+		return;
+
+	thumbnail = box_filter_surface (data->source, data->width, data->height);
+	if (thumbnail && data->inverted_colors)
+		ev_document_misc_invert_surface (thumbnail);
+
+	g_task_return_pointer (task, thumbnail, (GDestroyNotify)cairo_surface_destroy);
+}
+
+/* Downsamples are cancelled like cache lookups, the view might have
+ * modified the surface in that case */
+static void
+downsample_cb (GObject             *source_object,
+	       GAsyncResult        *result,
+	       ThumbnailLookupData *data)
+{
+	EvSidebarThumbnails *sidebar_thumbnails = data->sidebar_thumbnails;
+	EvSidebarThumbnailsPrivate *priv;
+	cairo_surface_t *thumbnail;
+	GError *error = NULL;
+
+	thumbnail = g_task_propagate_pointer (G_TASK (result), &error);
+	if (error) {
+		g_error_free (error);
+		g_slice_free (ThumbnailLookupData, data);
+		return;
+	}
+
+	priv = sidebar_thumbnails->priv;
+	g_hash_table_remove (priv->cache_lookups, GINT_TO_POINTER (data->page));
+
+	if (thumbnail) {
+		ev_sidebar_thumbnails_set_thumbnail (sidebar_thumbnails, data->page, thumbnail);
+		ev_thumbnail_cache_save (priv->thumbnail_cache, data->page, priv->rotation,
+					 data->width, data->height,
+					 thumbnail);
+		cairo_surface_destroy (thumbnail);
+	} else {
+		render_thumbnail_job (sidebar_thumbnails, data->page, data->width, data->height);
+	}
+
+	g_slice_free (ThumbnailLookupData, data);
+}
+
+static void
+render_thumbnail (EvSidebarThumbnails *sidebar_thumbnails,
+		  gint                 page,
+		  gint                 thumbnail_width,
+		  gint                 thumbnail_height)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	ThumbnailLookupData *data;
+	DownsampleData *downsample;
+	cairo_surface_t *source;
+	GCancellable *cancellable;
+	GTask *task;
+
+	source = ev_sidebar_thumbnails_get_view_surface (sidebar_thumbnails, page,
+							 thumbnail_width,
+							 thumbnail_height);
+	if (!source) {
+		render_thumbnail_job (sidebar_thumbnails, page,
+				      thumbnail_width, thumbnail_height);
+		return;
+	}
+
+	/* Downsampling a view surface reads every one of its pixels,
+	 * it's done in a thread tracked like the cache lookups */
+	data = g_slice_new (ThumbnailLookupData);
+	data->sidebar_thumbnails = sidebar_thumbnails;
+	data->page = page;
+	data->width = thumbnail_width;
+	data->height = thumbnail_height;
+
+	downsample = g_slice_new (DownsampleData);
+	downsample->source = source;
+	downsample->width = thumbnail_width;
+	downsample->height = thumbnail_height;
+	downsample->inverted_colors = priv->inverted_colors;
+
+	cancellable = g_cancellable_new ();
+	g_hash_table_insert (priv->cache_lookups, GINT_TO_POINTER (page), cancellable);
+
+	task = g_task_new (NULL, cancellable, (GAsyncReadyCallback)downsample_cb, data);
+	g_task_set_task_data (task, downsample, (GDestroyNotify)downsample_data_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc)downsample_thread);
+	g_object_unref (task);
+}
+
+/* Lookups are cancelled when the page is no longer visible or the
+ * model is cleared, the sidebar is not touched in that case */
+static void
+thumbnail_cache_lookup_cb (GObject             *source_object,
+			   GAsyncResult        *result,
+			   ThumbnailLookupData *data)
+{
+	EvSidebarThumbnails *sidebar_thumbnails = data->sidebar_thumbnails;
+	cairo_surface_t *thumbnail;
+	GError *error = NULL;
+
+	thumbnail = ev_thumbnail_cache_lookup_finish (result, &error);
+	if (error) {
+		g_error_free (error);
+		g_slice_free (ThumbnailLookupData, data);
+		return;
+	}
+
+	g_hash_table_remove (sidebar_thumbnails->priv->cache_lookups, GINT_TO_POINTER (data->page));
+
+	if (thumbnail) {
+		ev_sidebar_thumbnails_set_thumbnail (sidebar_thumbnails, data->page, thumbnail);
+		cairo_surface_destroy (thumbnail);
+	} else {
+		render_thumbnail (sidebar_thumbnails, data->page, data->width, data->height);
+	}
+
+	g_slice_free (ThumbnailLookupData, data);
+}
+
 static void
 add_range (EvSidebarThumbnails *sidebar_thumbnails,
 	   gint                 start_page,
 	   gint                 end_page)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreePath *path;
-	GtkTreeIter iter;
-	gboolean result;
-	gint page = start_page;
+	gint page;
 
 	g_assert (start_page <= end_page);
 
-	path = gtk_tree_path_new_from_indices (start_page, -1);
-	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
-	     result && page <= end_page;
-	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), page ++) {
-		EvJob *job;
-		gboolean thumbnail_set;
-
-		gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store), &iter,
-				    COLUMN_JOB, &job,
-				    COLUMN_THUMBNAIL_SET, &thumbnail_set,
-				    -1);
-
-		if (job == NULL && !thumbnail_set) {
-			gint thumbnail_width, thumbnail_height;
-			get_size_for_page (sidebar_thumbnails, page, &thumbnail_width, &thumbnail_height);
-
-			job = ev_job_thumbnail_new_with_target_size (priv->document,
-								     page, priv->rotation,
-								     thumbnail_width, thumbnail_height);
-                        ev_job_thumbnail_set_has_frame (EV_JOB_THUMBNAIL (job), FALSE);
-                        ev_job_thumbnail_set_output_format (EV_JOB_THUMBNAIL (job), EV_JOB_THUMBNAIL_SURFACE);
-			g_object_set_data_full (G_OBJECT (job), "tree_iter",
-						gtk_tree_iter_copy (&iter),
-						(GDestroyNotify) gtk_tree_iter_free);
-			g_signal_connect (job, "finished",
-					  G_CALLBACK (thumbnail_job_completed_callback),
-					  sidebar_thumbnails);
-			gtk_list_store_set (priv->list_store, &iter,
-					    COLUMN_JOB, job,
-					    -1);
-			ev_job_scheduler_push_job (EV_JOB (job), EV_JOB_PRIORITY_HIGH);
-			
-			/* The queue and the list own a ref to the job now */
-			g_object_unref (job);
-		} else if (job) {
-			g_object_unref (job);
-		}
+	for (page = start_page; page <= MIN (end_page, priv->n_pages - 1); page++) {
+		ThumbnailLookupData *data;
+		GCancellable *cancellable;
+
+		if (g_hash_table_lookup (priv->jobs, GINT_TO_POINTER (page)) ||
+		    g_hash_table_lookup (priv->cache_lookups, GINT_TO_POINTER (page)) ||
+		    ev_thumbnails_model_has_thumbnail (priv->thumbnails_model, page))
+			continue;
+
+		/* Thumbnails are rendered only if they are not in the
+		 * cache, PNG files are loaded in a thread */
+		data = g_slice_new (ThumbnailLookupData);
+		data->sidebar_thumbnails = sidebar_thumbnails;
+		data->page = page;
+		get_size_for_page (sidebar_thumbnails, page, &data->width, &data->height);
+
+		cancellable = g_cancellable_new ();
+		g_hash_table_insert (priv->cache_lookups, GINT_TO_POINTER (page), cancellable);
+		ev_thumbnail_cache_lookup_async (priv->thumbnail_cache, page, priv->rotation,
+						 data->width, data->height,
+						 cancellable,
+						 (GAsyncReadyCallback)thumbnail_cache_lookup_cb,
+						 data);
 	}
-	gtk_tree_path_free (path);
 }
 
 /* This modifies start */
@@ -552,6 +859,7 @@ update_visible_range (EvSidebarThumbnails *sidebar_thumbnails,
 	if (old_end_page > 0 && old_end_page > end_page)
 		clear_range (sidebar_thumbnails, MAX (end_page + 1, old_start_page), old_end_page);
 
+	ev_thumbnails_model_set_visible_range (priv->thumbnails_model, start_page, end_page);
 	add_range (sidebar_thumbnails, start_page, end_page);
 	
 	priv->start_page = start_page;
@@ -619,40 +927,11 @@ static void
 ev_sidebar_thumbnails_fill_model (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreeIter iter;
-	int i;
-	gint prev_width = -1;
-	gint prev_height = -1;
-
-	for (i = 0; i < sidebar_thumbnails->priv->n_pages; i++) {
-		gchar     *page_label;
-		gchar     *page_string;
-		cairo_surface_t *loading_icon = NULL;
-		gint       width, height;
-
-		page_label = ev_document_get_page_label (priv->document, i);
-		page_string = g_markup_printf_escaped ("<i>%s</i>", page_label);
-		ev_thumbnails_size_cache_get_size (sidebar_thumbnails->priv->size_cache, i,
-						  sidebar_thumbnails->priv->rotation,
-						  &width, &height);
-		if (!loading_icon || (width != prev_width && height != prev_height)) {
-			loading_icon =
-				ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails,
-									width, height);
-		}
 
-		prev_width = width;
-		prev_height = height;
-		
-		gtk_list_store_append (priv->list_store, &iter);
-		gtk_list_store_set (priv->list_store, &iter,
-				    COLUMN_PAGE_STRING, page_string,
-				    COLUMN_SURFACE, loading_icon,
-				    COLUMN_THUMBNAIL_SET, FALSE,
-				    -1);
-		g_free (page_label);
-		g_free (page_string);
-	}
+	ev_thumbnails_model_set_document (priv->thumbnails_model,
+					  priv->document,
+					  (EvThumbnailsModelLoadingFunc)ev_sidebar_thumbnails_get_loading_icon_for_page,
+					  sidebar_thumbnails);
 }
 
 static void
@@ -667,7 +946,7 @@ ev_sidebar_tree_selection_changed (GtkTreeSelection *selection,
 	if (!gtk_tree_selection_get_selected (selection, NULL, &iter))
 		return;
 
-	path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->list_store),
+	path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->thumbnails_model),
 					&iter);
 	page = gtk_tree_path_get_indices (path)[0];
 	gtk_tree_path_free (path);
@@ -708,7 +987,7 @@ ev_sidebar_init_tree_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
 	GtkCellRenderer *renderer;
 
 	priv = ev_sidebar_thumbnails->priv;
-	priv->tree_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (priv->list_store));
+	priv->tree_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (priv->thumbnails_model));
 
 	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
 	g_signal_connect (selection, "changed",
@@ -720,11 +999,11 @@ ev_sidebar_init_tree_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
 				 NULL);
 	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (priv->tree_view), -1,
 						     NULL, renderer,
-						     "surface", 1,
+						     "surface", EV_THUMBNAILS_MODEL_COLUMN_SURFACE,
 						     NULL);
 	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (priv->tree_view), -1,
 						     NULL, gtk_cell_renderer_text_new (),
-						     "markup", 0, NULL);
+						     "markup", EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING, NULL);
 	gtk_container_add (GTK_CONTAINER (priv->swindow), priv->tree_view);
 	gtk_widget_show (priv->tree_view);
 }
@@ -737,7 +1016,7 @@ ev_sidebar_init_icon_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
 
 	priv = ev_sidebar_thumbnails->priv;
 
-	priv->icon_view = gtk_icon_view_new_with_model (GTK_TREE_MODEL (priv->list_store));
+	priv->icon_view = gtk_icon_view_new_with_model (GTK_TREE_MODEL (priv->thumbnails_model));
 
         renderer = g_object_new (GTK_TYPE_CELL_RENDERER_PIXBUF,
                                  "xalign", 0.5,
@@ -745,7 +1024,7 @@ ev_sidebar_init_icon_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
                                  NULL);
         gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (priv->icon_view), renderer, FALSE);
         gtk_cell_layout_set_attributes (GTK_CELL_LAYOUT (priv->icon_view),
-                                        renderer, "surface", 1, NULL);
+                                        renderer, "surface", EV_THUMBNAILS_MODEL_COLUMN_SURFACE, NULL);
 
         renderer = g_object_new (GTK_TYPE_CELL_RENDERER_TEXT,
                                  "alignment", PANGO_ALIGN_CENTER,
@@ -757,7 +1036,7 @@ ev_sidebar_init_icon_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
                                  NULL);
         gtk_cell_layout_pack_end (GTK_CELL_LAYOUT (priv->icon_view), renderer, FALSE);
         gtk_cell_layout_set_attributes (GTK_CELL_LAYOUT (priv->icon_view),
-                                        renderer, "markup", 0, NULL);
+                                        renderer, "markup", EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING, NULL);
 	g_signal_connect (priv->icon_view, "selection-changed",
 			  G_CALLBACK (ev_sidebar_icon_selection_changed), ev_sidebar_thumbnails);
 
@@ -780,11 +1059,15 @@ ev_sidebar_thumbnails_init (EvSidebarThumbnails *ev_sidebar_thumbnails)
 
 	priv = ev_sidebar_thumbnails->priv = EV_SIDEBAR_THUMBNAILS_GET_PRIVATE (ev_sidebar_thumbnails);
 
-	priv->list_store = gtk_list_store_new (NUM_COLUMNS,
-					       G_TYPE_STRING,
-					       CAIRO_GOBJECT_TYPE_SURFACE,
-					       G_TYPE_BOOLEAN,
-					       EV_TYPE_JOB_THUMBNAIL);
+	priv->thumbnails_model = ev_thumbnails_model_new ();
+	priv->jobs = g_hash_table_new_full (g_direct_hash,
+					    g_direct_equal,
+					    NULL,
+					    (GDestroyNotify)g_object_unref);
+	priv->cache_lookups = g_hash_table_new_full (g_direct_hash,
+						     g_direct_equal,
+						     NULL,
+						     (GDestroyNotify)cancel_and_unref);
 
 	priv->swindow = gtk_scrolled_window_new (NULL, NULL);
 
@@ -900,30 +1183,57 @@ ev_sidebar_thumbnails_inverted_colors_changed_cb (EvDocumentModel     *model,
 }
 
 static void
-thumbnail_job_completed_callback (EvJobThumbnail      *job,
-				  EvSidebarThumbnails *sidebar_thumbnails)
+ev_sidebar_thumbnails_set_thumbnail (EvSidebarThumbnails *sidebar_thumbnails,
+				     gint                 page,
+				     cairo_surface_t     *thumbnail)
 {
         GtkWidget                  *widget = GTK_WIDGET (sidebar_thumbnails);
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreeIter                *iter;
         cairo_surface_t            *surface;
 
         surface = ev_document_misc_render_thumbnail_surface_with_frame (widget,
-                                                                        job->thumbnail_surface,
+                                                                        thumbnail,
                                                                         -1, -1);
 
-	iter = (GtkTreeIter *) g_object_get_data (G_OBJECT (job), "tree_iter");
 	if (priv->inverted_colors)
 		ev_document_misc_invert_surface (surface);
-	gtk_list_store_set (priv->list_store,
-			    iter,
-			    COLUMN_SURFACE, surface,
-			    COLUMN_THUMBNAIL_SET, TRUE,
-			    COLUMN_JOB, NULL,
-			    -1);
+	ev_thumbnails_model_set_thumbnail (priv->thumbnails_model, page, surface);
         cairo_surface_destroy (surface);
 }
 
+static void
+thumbnail_job_completed_callback (EvJobThumbnail      *job,
+				  EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	ev_sidebar_thumbnails_set_thumbnail (sidebar_thumbnails, job->page, job->thumbnail_surface);
+	ev_thumbnail_cache_save (priv->thumbnail_cache, job->page, job->rotation,
+				 job->target_width, job->target_height,
+				 job->thumbnail_surface);
+
+	g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, sidebar_thumbnails);
+	g_hash_table_remove (priv->jobs, GINT_TO_POINTER (job->page));
+}
+
+static void
+ev_sidebar_thumbnails_page_size_changed_cb (EvDocument          *document,
+					    gint                 page,
+					    EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	if (document != priv->document)
+		return;
+
+	if (priv->size_cache->uniform) {
+		g_object_set_data (G_OBJECT (document), EV_THUMBNAILS_SIZE_CACHE_KEY, NULL);
+		priv->size_cache = ev_thumbnails_size_cache_get (document);
+	} else {
+		priv->size_cache->sizes[page].width = 0;
+	}
+}
+
 static void
 ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 					   GParamSpec          *pspec,
@@ -937,7 +1247,14 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 		return;
 	}
 
+	if (document != priv->document) {
+		g_signal_connect_object (document, "page-size-changed",
+					 G_CALLBACK (ev_sidebar_thumbnails_page_size_changed_cb),
+					 sidebar_thumbnails, 0);
+	}
+
 	priv->size_cache = ev_thumbnails_size_cache_get (document);
+	priv->thumbnail_cache = ev_thumbnail_cache_get_for_document (document);
 	priv->document = document;
 	priv->n_pages = ev_document_get_n_pages (document);
 	priv->rotation = ev_document_model_get_rotation (model);
@@ -1008,32 +1325,20 @@ ev_sidebar_thumbnails_set_model (EvSidebarPage   *sidebar_page,
 			  sidebar_page);
 }
 
-static gboolean
-ev_sidebar_thumbnails_clear_job (GtkTreeModel *model,                                             
-			         GtkTreePath *path,
-			         GtkTreeIter *iter,
-				 gpointer data)
-{
-	EvJob *job;
-	
-	gtk_tree_model_get (model, iter, COLUMN_JOB, &job, -1);
-	
-	if (job != NULL) {
-		ev_job_cancel (job);
-		g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, data);
-		g_object_unref (job);
-	}
-	
-	return FALSE;    
-}
-
 static void 
 ev_sidebar_thumbnails_clear_model (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	
-	gtk_tree_model_foreach (GTK_TREE_MODEL (priv->list_store), ev_sidebar_thumbnails_clear_job, sidebar_thumbnails);
-	gtk_list_store_clear (priv->list_store);
+	GHashTableIter iter;
+	gpointer job;
+
+	g_hash_table_iter_init (&iter, priv->jobs);
+	while (g_hash_table_iter_next (&iter, NULL, &job))
+		ev_sidebar_thumbnails_cancel_job (sidebar_thumbnails, EV_JOB (job));
+	g_hash_table_remove_all (priv->jobs);
+	g_hash_table_remove_all (priv->cache_lookups);
+
+	ev_thumbnails_model_set_document (priv->thumbnails_model, NULL, NULL, NULL);
 }
 
 static gboolean
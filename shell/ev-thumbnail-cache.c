@@ -0,0 +1,403 @@
+/* ev-thumbnail-cache.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Sidebar thumbnails are written as PNG files to the user cache
+ * directory, one directory per document keyed by ev_document_get_cache_key(),
+ * so that they can be shown without rendering the pages again when the
+ * document is opened, rotated or reloaded. Files are read and written
+ * from threads. Their modification time is updated when they are used, and
+ * the least recently used ones are removed when the cache, shared by all
+ * documents, grows beyond EV_THUMBNAIL_CACHE_MAX_SIZE.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "ev-thumbnail-cache.h"
+
+#define EV_THUMBNAIL_CACHE_MAX_SIZE   (64 * 1024 * 1024)
+#define EV_THUMBNAIL_CACHE_DATA_KEY   "ev-thumbnail-cache"
+
+struct _EvThumbnailCache {
+	EvDocument *document;
+	gchar      *dirname;
+};
+
+typedef struct {
+	gchar           *filename;
+	cairo_surface_t *surface;
+} EvThumbnailCacheSaveData;
+
+typedef struct {
+	gchar  *filename;
+	time_t  mtime;
+	goffset size;
+} EvThumbnailCacheFile;
+
+/* Bytes written since the cache was last trimmed, shared by all documents */
+G_LOCK_DEFINE_STATIC (trim);
+static gboolean trimmed = FALSE;
+static goffset  bytes_written = 0;
+
+static gchar *
+ev_thumbnail_cache_get_root (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "evince", "thumbnails", NULL);
+}
+
+static void
+ev_thumbnail_cache_free (EvThumbnailCache *cache)
+{
+	g_free (cache->dirname);
+	g_free (cache);
+}
+
+static gchar *
+ev_thumbnail_cache_get_filename (EvThumbnailCache *cache,
+				 gint              page,
+				 gint              rotation,
+				 gint              width,
+				 gint              height)
+{
+	gchar *basename;
+	gchar *filename;
+
+	basename = g_strdup_printf ("%d-%dx%d-%d.png", page, width, height, rotation);
+	filename = g_build_filename (cache->dirname, basename, NULL);
+	g_free (basename);
+
+	return filename;
+}
+
+/* The key is computed when the document is loaded, or for documents
+ * loaded from a stream once the stream has been copied to a local file,
+ * so this is tried again until there's one. Returns whether the cache
+ * can be used.
+ */
+static gboolean
+ev_thumbnail_cache_ensure_dir (EvThumbnailCache *cache)
+{
+	const gchar *key;
+	gchar       *root;
+
+	if (cache->dirname)
+		return TRUE;
+
+	key = ev_document_get_cache_key (cache->document);
+	if (!key)
+		return FALSE;
+
+	root = ev_thumbnail_cache_get_root ();
+	cache->dirname = g_build_filename (root, key, NULL);
+	g_free (root);
+
+	return TRUE;
+}
+
+/**
+ * ev_thumbnail_cache_get_for_document:
+ * @document: an #EvDocument
+ *
+ * Returns: (transfer none): the thumbnail cache of @document, created the
+ *   first time it's requested. Documents without a cache key, like those
+ *   that are not local files or needed a password, get a cache that never
+ *   stores anything.
+ */
+EvThumbnailCache *
+ev_thumbnail_cache_get_for_document (EvDocument *document)
+{
+	EvThumbnailCache *cache;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+
+	cache = g_object_get_data (G_OBJECT (document), EV_THUMBNAIL_CACHE_DATA_KEY);
+	if (cache)
+		return cache;
+
+	/* The cache is owned by the document, no need to keep a reference */
+	cache = g_new0 (EvThumbnailCache, 1);
+	cache->document = document;
+	g_object_set_data_full (G_OBJECT (document), EV_THUMBNAIL_CACHE_DATA_KEY,
+				cache, (GDestroyNotify)ev_thumbnail_cache_free);
+
+	return cache;
+}
+
+static void
+lookup_thread (GTask        *task,
+	       gpointer      source_object,
+	       const gchar  *filename,
+	       GCancellable *cancellable)
+{
+	cairo_surface_t *surface;
+
+	if (!g_file_test (filename, G_FILE_TEST_IS_REGULAR)) {
+		g_task_return_pointer (task, NULL, NULL);
+		return;
+	}
+
+	surface = cairo_image_surface_create_from_png (filename);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (surface);
+		g_unlink (filename);
+		g_task_return_pointer (task, NULL, NULL);
+		return;
+	}
+
+	/* Mark it as recently used */
+	g_utime (filename, NULL);
+
+	g_task_return_pointer (task, surface, (GDestroyNotify)cairo_surface_destroy);
+}
+
+/**
+ * ev_thumbnail_cache_lookup_async:
+ * @cache: an #EvThumbnailCache
+ * @page: the page index
+ * @rotation: the rotation of the thumbnail
+ * @width: the width the thumbnail was requested at
+ * @height: the height the thumbnail was requested at
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to call when the lookup is done
+ * @user_data: the data to pass to @callback
+ *
+ * Loads the cached thumbnail from a thread. Call
+ * ev_thumbnail_cache_lookup_finish() from @callback to get it.
+ */
+void
+ev_thumbnail_cache_lookup_async (EvThumbnailCache   *cache,
+				 gint                page,
+				 gint                rotation,
+				 gint                width,
+				 gint                height,
+				 GCancellable       *cancellable,
+				 GAsyncReadyCallback callback,
+				 gpointer            user_data)
+{
+	GTask *task;
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	if (!ev_thumbnail_cache_ensure_dir (cache)) {
+		g_task_return_pointer (task, NULL, NULL);
+		g_object_unref (task);
+		return;
+	}
+
+	g_task_set_task_data (task,
+			      ev_thumbnail_cache_get_filename (cache, page, rotation, width, height),
+			      g_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc)lookup_thread);
+	g_object_unref (task);
+}
+
+/**
+ * ev_thumbnail_cache_lookup_finish:
+ * @result: the #GAsyncResult passed to the callback
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Returns: (transfer full): the cached thumbnail, or %NULL if it's not
+ *   in the cache or the lookup was cancelled
+ */
+cairo_surface_t *
+ev_thumbnail_cache_lookup_finish (GAsyncResult *result,
+				  GError      **error)
+{
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static gint
+compare_files_by_mtime (const EvThumbnailCacheFile *a,
+			const EvThumbnailCacheFile *b)
+{
+	return a->mtime < b->mtime ? -1 : a->mtime > b->mtime ? 1 : 0;
+}
+
+/* Removes the least recently used thumbnails, of any document, until the
+ * cache is back to three quarters of its maximum size.
+ */
+static void
+ev_thumbnail_cache_trim (void)
+{
+	GArray      *files;
+	GDir        *root_dir;
+	gchar       *root;
+	const gchar *name;
+	goffset      total_size = 0;
+	guint        i;
+
+	root = ev_thumbnail_cache_get_root ();
+	root_dir = g_dir_open (root, 0, NULL);
+	if (!root_dir) {
+		g_free (root);
+		return;
+	}
+
+	files = g_array_new (FALSE, FALSE, sizeof (EvThumbnailCacheFile));
+	while ((name = g_dir_read_name (root_dir))) {
+		GDir        *dir;
+		gchar       *dirname;
+		const gchar *basename;
+
+		dirname = g_build_filename (root, name, NULL);
+		dir = g_dir_open (dirname, 0, NULL);
+		if (!dir) {
+			g_free (dirname);
+			continue;
+		}
+
+		while ((basename = g_dir_read_name (dir))) {
+			EvThumbnailCacheFile file;
+			GStatBuf             statbuf;
+
+			file.filename = g_build_filename (dirname, basename, NULL);
+			if (g_stat (file.filename, &statbuf) == -1) {
+				g_free (file.filename);
+				continue;
+			}
+
+			file.mtime = statbuf.st_mtime;
+			file.size = statbuf.st_size;
+			total_size += file.size;
+			g_array_append_val (files, file);
+		}
+		g_dir_close (dir);
+		g_free (dirname);
+	}
+	g_dir_close (root_dir);
+
+	if (total_size > EV_THUMBNAIL_CACHE_MAX_SIZE) {
+		g_array_sort (files, (GCompareFunc)compare_files_by_mtime);
+		for (i = 0; i < files->len && total_size > EV_THUMBNAIL_CACHE_MAX_SIZE / 4 * 3; i++) {
+			EvThumbnailCacheFile *file = &g_array_index (files, EvThumbnailCacheFile, i);
+			gchar                *dirname;
+
+			if (g_unlink (file->filename) == -1)
+				continue;
+
+			total_size -= file->size;
+
+			/* Fails unless it was the last thumbnail of the document */
+			dirname = g_path_get_dirname (file->filename);
+			g_rmdir (dirname);
+			g_free (dirname);
+		}
+	}
+
+	for (i = 0; i < files->len; i++)
+		g_free (g_array_index (files, EvThumbnailCacheFile, i).filename);
+	g_array_free (files, TRUE);
+	g_free (root);
+}
+
+static void
+ev_thumbnail_cache_save_data_free (EvThumbnailCacheSaveData *data)
+{
+	g_free (data->filename);
+	cairo_surface_destroy (data->surface);
+	g_slice_free (EvThumbnailCacheSaveData, data);
+}
+
+static void
+save_thread (GTask                    *task,
+	     gpointer                  source_object,
+	     EvThumbnailCacheSaveData *data,
+	     GCancellable             *cancellable)
+{
+	gchar    *dirname;
+	gchar    *tmp_filename;
+	GStatBuf  statbuf;
+	gboolean  trim = FALSE;
+	int       fd;
+
+	dirname = g_path_get_dirname (data->filename);
+	if (g_mkdir_with_parents (dirname, 0700) == -1) {
+		g_free (dirname);
+		return;
+	}
+
+	/* Write to a temporary file so that lookups never see partial files */
+	tmp_filename = g_build_filename (dirname, ".thumbnail-XXXXXX", NULL);
+	g_free (dirname);
+	fd = g_mkstemp (tmp_filename);
+	if (fd == -1) {
+		g_free (tmp_filename);
+		return;
+	}
+	close (fd);
+
+	if (cairo_surface_write_to_png (data->surface, tmp_filename) != CAIRO_STATUS_SUCCESS ||
+	    g_rename (tmp_filename, data->filename) == -1) {
+		g_unlink (tmp_filename);
+		g_free (tmp_filename);
+		return;
+	}
+	g_free (tmp_filename);
+
+	G_LOCK (trim);
+	if (g_stat (data->filename, &statbuf) == 0)
+		bytes_written += statbuf.st_size;
+	if (!trimmed || bytes_written > EV_THUMBNAIL_CACHE_MAX_SIZE / 8) {
+		trimmed = TRUE;
+		bytes_written = 0;
+		trim = TRUE;
+	}
+	G_UNLOCK (trim);
+
+	if (trim)
+		ev_thumbnail_cache_trim ();
+}
+
+/**
+ * ev_thumbnail_cache_save:
+ * @cache: an #EvThumbnailCache
+ * @page: the page index
+ * @rotation: the rotation of the thumbnail
+ * @width: the width the thumbnail was requested at
+ * @height: the height the thumbnail was requested at
+ * @surface: the thumbnail
+ *
+ * Writes @surface to the cache in a thread. @surface must not be
+ * modified afterwards. Errors are ignored, the thumbnail will just be
+ * rendered again the next time.
+ */
+void
+ev_thumbnail_cache_save (EvThumbnailCache *cache,
+			 gint              page,
+			 gint              rotation,
+			 gint              width,
+			 gint              height,
+			 cairo_surface_t  *surface)
+{
+	EvThumbnailCacheSaveData *data;
+	GTask                    *task;
+
+	if (!surface || !ev_thumbnail_cache_ensure_dir (cache))
+		return;
+
+	data = g_slice_new (EvThumbnailCacheSaveData);
+	data->filename = ev_thumbnail_cache_get_filename (cache, page, rotation, width, height);
+	data->surface = cairo_surface_reference (surface);
+
+	task = g_task_new (NULL, NULL, NULL, NULL);
+	g_task_set_task_data (task, data, (GDestroyNotify)ev_thumbnail_cache_save_data_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc)save_thread);
+	g_object_unref (task);
+}
@@ -0,0 +1,508 @@
+/* ev-thumbnails-model.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* A list model with one row per page of a document that doesn't store
+ * anything per row. Page labels are built when a view asks for them and
+ * pages without a thumbnail share the loading surface returned by the
+ * loading function. Only rendered thumbnails are kept, in a bounded LRU,
+ * so that the memory used doesn't grow with the number of pages.
+ */
+
+#include "config.h"
+
+#include <cairo-gobject.h>
+
+#include "ev-thumbnails-model.h"
+
+#define DEFAULT_MAX_THUMBNAILS 128
+
+typedef struct {
+	gint             page;
+	cairo_surface_t *surface;
+	GList           *lru_link;
+} EvThumbnailsModelItem;
+
+struct _EvThumbnailsModelPrivate {
+	EvDocument *document;
+	gint        n_pages;
+	gint        stamp;
+
+	EvThumbnailsModelLoadingFunc loading_func;
+	gpointer                     loading_data;
+
+	/* Rendered thumbnails, most recently used first */
+	GHashTable *items;
+	GQueue      lru;
+	guint       max_thumbnails;
+
+	/* Pages whose thumbnails are never evicted */
+	gint start_page;
+	gint end_page;
+};
+
+static void ev_thumbnails_model_tree_model_iface_init (GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (EvThumbnailsModel, ev_thumbnails_model, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+						ev_thumbnails_model_tree_model_iface_init))
+
+static void
+ev_thumbnails_model_item_free (EvThumbnailsModelItem *item)
+{
+	cairo_surface_destroy (item->surface);
+	g_slice_free (EvThumbnailsModelItem, item);
+}
+
+static void
+ev_thumbnails_model_row_changed (EvThumbnailsModel *model,
+				 gint               page)
+{
+	GtkTreePath *path;
+	GtkTreeIter  iter;
+
+	iter.stamp = model->priv->stamp;
+	iter.user_data = GINT_TO_POINTER (page);
+
+	path = gtk_tree_path_new_from_indices (page, -1);
+	gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+	gtk_tree_path_free (path);
+}
+
+static void
+ev_thumbnails_model_evict (EvThumbnailsModel *model)
+{
+	EvThumbnailsModelPrivate *priv = model->priv;
+	GList                    *l;
+
+	l = priv->lru.tail;
+	while (l && priv->lru.length > priv->max_thumbnails) {
+		EvThumbnailsModelItem *item = (EvThumbnailsModelItem *)l->data;
+		gint                   page = item->page;
+
+		l = l->prev;
+
+		if (page >= priv->start_page && page <= priv->end_page)
+			continue;
+
+		g_queue_delete_link (&priv->lru, item->lru_link);
+		g_hash_table_remove (priv->items, GINT_TO_POINTER (page));
+		ev_thumbnails_model_row_changed (model, page);
+	}
+}
+
+static void
+ev_thumbnails_model_clear (EvThumbnailsModel *model)
+{
+	EvThumbnailsModelPrivate *priv = model->priv;
+
+	g_queue_clear (&priv->lru);
+	g_hash_table_remove_all (priv->items);
+}
+
+static void
+ev_thumbnails_model_finalize (GObject *object)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (object);
+
+	ev_thumbnails_model_clear (model);
+	g_hash_table_destroy (model->priv->items);
+
+	G_OBJECT_CLASS (ev_thumbnails_model_parent_class)->finalize (object);
+}
+
+static void
+ev_thumbnails_model_dispose (GObject *object)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (object);
+
+	g_clear_object (&model->priv->document);
+
+	G_OBJECT_CLASS (ev_thumbnails_model_parent_class)->dispose (object);
+}
+
+static void
+ev_thumbnails_model_init (EvThumbnailsModel *model)
+{
+	EvThumbnailsModelPrivate *priv;
+
+	priv = model->priv = G_TYPE_INSTANCE_GET_PRIVATE (model, EV_TYPE_THUMBNAILS_MODEL,
+							  EvThumbnailsModelPrivate);
+
+	priv->stamp = g_random_int ();
+	priv->items = g_hash_table_new_full (g_direct_hash,
+					     g_direct_equal,
+					     NULL,
+					     (GDestroyNotify)ev_thumbnails_model_item_free);
+	g_queue_init (&priv->lru);
+	priv->max_thumbnails = DEFAULT_MAX_THUMBNAILS;
+	priv->start_page = -1;
+	priv->end_page = -1;
+}
+
+static void
+ev_thumbnails_model_class_init (EvThumbnailsModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = ev_thumbnails_model_dispose;
+	object_class->finalize = ev_thumbnails_model_finalize;
+
+	g_type_class_add_private (object_class, sizeof (EvThumbnailsModelPrivate));
+}
+
+/* GtkTreeModel interface */
+static GtkTreeModelFlags
+ev_thumbnails_model_get_flags (GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_LIST_ONLY | GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint
+ev_thumbnails_model_get_n_columns (GtkTreeModel *tree_model)
+{
+	return EV_THUMBNAILS_MODEL_N_COLUMNS;
+}
+
+static GType
+ev_thumbnails_model_get_column_type (GtkTreeModel *tree_model,
+				     gint          index)
+{
+	switch (index) {
+	case EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING:
+		return G_TYPE_STRING;
+	case EV_THUMBNAILS_MODEL_COLUMN_SURFACE:
+		return CAIRO_GOBJECT_TYPE_SURFACE;
+	default:
+		g_assert_not_reached ();
+	}
+
+	return G_TYPE_INVALID;
+}
+
+static gboolean
+ev_thumbnails_model_iter_nth_child (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter,
+				    GtkTreeIter  *parent,
+				    gint          n)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+
+	if (parent || n < 0 || n >= model->priv->n_pages)
+		return FALSE;
+
+	iter->stamp = model->priv->stamp;
+	iter->user_data = GINT_TO_POINTER (n);
+
+	return TRUE;
+}
+
+static gboolean
+ev_thumbnails_model_get_iter (GtkTreeModel *tree_model,
+			      GtkTreeIter  *iter,
+			      GtkTreePath  *path)
+{
+	if (gtk_tree_path_get_depth (path) != 1)
+		return FALSE;
+
+	return ev_thumbnails_model_iter_nth_child (tree_model, iter, NULL,
+						   gtk_tree_path_get_indices (path)[0]);
+}
+
+static GtkTreePath *
+ev_thumbnails_model_get_path (GtkTreeModel *tree_model,
+			      GtkTreeIter  *iter)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+
+	g_return_val_if_fail (iter->stamp == model->priv->stamp, NULL);
+
+	return gtk_tree_path_new_from_indices (GPOINTER_TO_INT (iter->user_data), -1);
+}
+
+static void
+ev_thumbnails_model_get_value (GtkTreeModel *tree_model,
+			       GtkTreeIter  *iter,
+			       gint          column,
+			       GValue       *value)
+{
+	EvThumbnailsModel        *model = EV_THUMBNAILS_MODEL (tree_model);
+	EvThumbnailsModelPrivate *priv = model->priv;
+	gint                      page;
+
+	g_return_if_fail (iter->stamp == priv->stamp);
+
+	page = GPOINTER_TO_INT (iter->user_data);
+	g_value_init (value, ev_thumbnails_model_get_column_type (tree_model, column));
+
+	switch (column) {
+	case EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING: {
+		gchar *page_label;
+
+		page_label = ev_document_get_page_label (priv->document, page);
+		g_value_take_string (value, g_markup_printf_escaped ("<i>%s</i>", page_label));
+		g_free (page_label);
+	}
+		break;
+	case EV_THUMBNAILS_MODEL_COLUMN_SURFACE: {
+		EvThumbnailsModelItem *item;
+
+		item = g_hash_table_lookup (priv->items, GINT_TO_POINTER (page));
+		if (item)
+			g_value_set_boxed (value, item->surface);
+		else if (priv->loading_func)
+			g_value_set_boxed (value, priv->loading_func (page, priv->loading_data));
+	}
+		break;
+	}
+}
+
+static gboolean
+ev_thumbnails_model_iter_next (GtkTreeModel *tree_model,
+			       GtkTreeIter  *iter)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+	gint               page;
+
+	g_return_val_if_fail (iter->stamp == model->priv->stamp, FALSE);
+
+	page = GPOINTER_TO_INT (iter->user_data) + 1;
+	if (page >= model->priv->n_pages) {
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	iter->user_data = GINT_TO_POINTER (page);
+
+	return TRUE;
+}
+
+static gboolean
+ev_thumbnails_model_iter_previous (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+	gint               page;
+
+	g_return_val_if_fail (iter->stamp == model->priv->stamp, FALSE);
+
+	page = GPOINTER_TO_INT (iter->user_data) - 1;
+	if (page < 0) {
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	iter->user_data = GINT_TO_POINTER (page);
+
+	return TRUE;
+}
+
+static gboolean
+ev_thumbnails_model_iter_children (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter,
+				   GtkTreeIter  *parent)
+{
+	return ev_thumbnails_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+static gboolean
+ev_thumbnails_model_iter_has_child (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter)
+{
+	return FALSE;
+}
+
+static gint
+ev_thumbnails_model_iter_n_children (GtkTreeModel *tree_model,
+				     GtkTreeIter  *iter)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+
+	return iter ? 0 : model->priv->n_pages;
+}
+
+static gboolean
+ev_thumbnails_model_iter_parent (GtkTreeModel *tree_model,
+				 GtkTreeIter  *iter,
+				 GtkTreeIter  *child)
+{
+	return FALSE;
+}
+
+static void
+ev_thumbnails_model_tree_model_iface_init (GtkTreeModelIface *iface)
+{
+	iface->get_flags = ev_thumbnails_model_get_flags;
+	iface->get_n_columns = ev_thumbnails_model_get_n_columns;
+	iface->get_column_type = ev_thumbnails_model_get_column_type;
+	iface->get_iter = ev_thumbnails_model_get_iter;
+	iface->get_path = ev_thumbnails_model_get_path;
+	iface->get_value = ev_thumbnails_model_get_value;
+	iface->iter_next = ev_thumbnails_model_iter_next;
+	iface->iter_previous = ev_thumbnails_model_iter_previous;
+	iface->iter_children = ev_thumbnails_model_iter_children;
+	iface->iter_has_child = ev_thumbnails_model_iter_has_child;
+	iface->iter_n_children = ev_thumbnails_model_iter_n_children;
+	iface->iter_nth_child = ev_thumbnails_model_iter_nth_child;
+	iface->iter_parent = ev_thumbnails_model_iter_parent;
+}
+
+EvThumbnailsModel *
+ev_thumbnails_model_new (void)
+{
+	return EV_THUMBNAILS_MODEL (g_object_new (EV_TYPE_THUMBNAILS_MODEL, NULL));
+}
+
+/**
+ * ev_thumbnails_model_set_document:
+ * @model: an #EvThumbnailsModel
+ * @document: (allow-none): the document, or %NULL to empty the model
+ * @loading_func: (allow-none): function returning the surface of pages
+ *     without a thumbnail
+ * @user_data: data passed to @loading_func
+ *
+ * Replaces all the rows of @model with one row per page of @document,
+ * dropping all the thumbnails. This is also how views are told that
+ * every row changed, for instance after a rotation.
+ */
+void
+ev_thumbnails_model_set_document (EvThumbnailsModel           *model,
+				  EvDocument                  *document,
+				  EvThumbnailsModelLoadingFunc loading_func,
+				  gpointer                     user_data)
+{
+	EvThumbnailsModelPrivate *priv;
+	GtkTreePath              *path;
+	GtkTreeIter               iter;
+	gint                      n_pages;
+
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+	g_return_if_fail (document == NULL || EV_IS_DOCUMENT (document));
+
+	priv = model->priv;
+
+	ev_thumbnails_model_clear (model);
+
+	path = gtk_tree_path_new_from_indices (0, -1);
+	while (priv->n_pages > 0) {
+		priv->n_pages--;
+		gtk_tree_path_get_indices (path)[0] = priv->n_pages;
+		gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+	}
+
+	if (document)
+		g_object_ref (document);
+	if (priv->document)
+		g_object_unref (priv->document);
+	priv->document = document;
+	priv->loading_func = loading_func;
+	priv->loading_data = user_data;
+	priv->stamp++;
+
+	n_pages = document ? ev_document_get_n_pages (document) : 0;
+	iter.stamp = priv->stamp;
+	while (priv->n_pages < n_pages) {
+		gtk_tree_path_get_indices (path)[0] = priv->n_pages;
+		iter.user_data = GINT_TO_POINTER (priv->n_pages);
+		priv->n_pages++;
+		gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+	}
+	gtk_tree_path_free (path);
+}
+
+/**
+ * ev_thumbnails_model_set_visible_range:
+ * @model: an #EvThumbnailsModel
+ * @start_page: the first visible page
+ * @end_page: the last visible page
+ *
+ * Thumbnails of the pages in the given range are not evicted, however
+ * many there are.
+ */
+void
+ev_thumbnails_model_set_visible_range (EvThumbnailsModel *model,
+				       gint               start_page,
+				       gint               end_page)
+{
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	model->priv->start_page = start_page;
+	model->priv->end_page = end_page;
+	ev_thumbnails_model_evict (model);
+}
+
+void
+ev_thumbnails_model_set_max_thumbnails (EvThumbnailsModel *model,
+					guint              max_thumbnails)
+{
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	model->priv->max_thumbnails = max_thumbnails;
+	ev_thumbnails_model_evict (model);
+}
+
+gboolean
+ev_thumbnails_model_has_thumbnail (EvThumbnailsModel *model,
+				   gint               page)
+{
+	EvThumbnailsModelItem *item;
+
+	g_return_val_if_fail (EV_IS_THUMBNAILS_MODEL (model), FALSE);
+
+	item = g_hash_table_lookup (model->priv->items, GINT_TO_POINTER (page));
+	if (!item)
+		return FALSE;
+
+	/* Mark it as recently used */
+	g_queue_unlink (&model->priv->lru, item->lru_link);
+	g_queue_push_head_link (&model->priv->lru, item->lru_link);
+
+	return TRUE;
+}
+
+void
+ev_thumbnails_model_set_thumbnail (EvThumbnailsModel *model,
+				   gint               page,
+				   cairo_surface_t   *surface)
+{
+	EvThumbnailsModelPrivate *priv;
+	EvThumbnailsModelItem    *item;
+
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+	g_return_if_fail (surface != NULL);
+
+	priv = model->priv;
+	g_return_if_fail (page >= 0 && page < priv->n_pages);
+
+	item = g_hash_table_lookup (priv->items, GINT_TO_POINTER (page));
+	if (item) {
+		cairo_surface_destroy (item->surface);
+		g_queue_unlink (&priv->lru, item->lru_link);
+	} else {
+		item = g_slice_new (EvThumbnailsModelItem);
+		item->page = page;
+		item->lru_link = g_list_alloc ();
+		item->lru_link->data = item;
+		g_hash_table_insert (priv->items, GINT_TO_POINTER (page), item);
+	}
+
+	item->surface = cairo_surface_reference (surface);
+	g_queue_push_head_link (&priv->lru, item->lru_link);
+
+	ev_thumbnails_model_row_changed (model, page);
+	ev_thumbnails_model_evict (model);
+}
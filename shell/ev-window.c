@@ -86,6 +86,7 @@
 #include "ev-window-title.h"
 #include "ev-print-operation.h"
 #include "ev-progress-message-area.h"
+#include "ev-range-input-stream.h"
 #include "ev-annotation-properties-dialog.h"
 #include "ev-bookmarks.h"
 #include "ev-bookmark-action.h"
@@ -155,6 +156,10 @@ struct _EvWindowPrivate {
 	guint progress_idle;
 	GCancellable *progress_cancellable;
 
+	/* Remote documents loaded on demand */
+	GCancellable *range_fetch_cancellable;
+	gboolean      local_uri_partial;
+
 	/* Fullscreen */
 	GtkWidget *fs_overlay;
 	GtkWidget *fs_eventbox;
@@ -213,6 +218,7 @@ struct _EvWindowPrivate {
 	EvWindowRunMode   window_mode;
 
 	EvJob            *load_job;
+	EvJob            *load_stream_job;
 	EvJob            *reload_job;
 	EvJob            *thumbnail_job;
 	EvJob            *save_job;
@@ -261,6 +267,7 @@ struct _EvWindowPrivate {
 #define GS_SCHEMA_NAME           "org.gnome.Evince"
 #define GS_OVERRIDE_RESTRICTIONS "override-restrictions"
 #define GS_PAGE_CACHE_SIZE       "page-cache-size"
+#define GS_PAGE_DATA_CACHE_SIZE  "page-data-cache-size"
 #define GS_AUTO_RELOAD           "auto-reload"
 #define GS_LAST_DOCUMENT_DIRECTORY "document-directory"
 #define GS_LAST_PICTURES_DIRECTORY "pictures-directory"
@@ -308,6 +315,10 @@ static void     ev_window_set_page_mode                 (EvWindow         *windo
 							 EvWindowPageMode  page_mode);
 static void	ev_window_load_job_cb  			(EvJob            *job,
 							 gpointer          data);
+static void	ev_window_load_stream_job_cb		(EvJob            *job,
+							 EvWindow         *ev_window);
+static void	ev_window_copy_file_remote		(EvWindow         *ev_window,
+							 GFile            *source_file);
 static void     ev_window_reload_document               (EvWindow         *window,
 							 EvLinkDest *dest);
 static void     ev_window_reload_job_cb                 (EvJob            *job,
@@ -469,7 +480,8 @@ ev_window_setup_action_sensitivity (EvWindow *ev_window)
 	ev_window_set_action_sensitive (ev_window, "FileProperties", has_document && has_properties);
 	ev_window_set_action_sensitive (ev_window, "FileOpenContainingFolder", has_document);
 	ev_window_set_action_sensitive (ev_window, "FileSendTo",
-					has_document && ev_window->priv->has_mailto_handler);
+					has_document && ev_window->priv->has_mailto_handler &&
+					!ev_window->priv->local_uri_partial);
 	ev_window_set_action_sensitive (ev_window, "ViewPresentation", has_document);
 
         /* Edit menu */
@@ -1338,6 +1350,18 @@ page_cache_size_changed (GSettings *settings,
 				     page_cache_mb * 1024 * 1024);
 }
 
+static void
+page_data_cache_size_changed (GSettings *settings,
+			      gchar     *key,
+			      EvWindow  *ev_window)
+{
+	guint page_data_cache_mb;
+
+	page_data_cache_mb = g_settings_get_uint (settings, GS_PAGE_DATA_CACHE_SIZE);
+	ev_view_set_page_data_cache_size (EV_VIEW (ev_window->priv->view),
+					  page_data_cache_mb * 1024 * 1024);
+}
+
 static void
 ev_window_setup_default (EvWindow *ev_window)
 {
@@ -1455,6 +1479,10 @@ ev_window_ensure_settings (EvWindow *ev_window)
 			  "changed::"GS_PAGE_CACHE_SIZE,
 			  G_CALLBACK (page_cache_size_changed),
 			  ev_window);
+        g_signal_connect (priv->settings,
+			  "changed::"GS_PAGE_DATA_CACHE_SIZE,
+			  G_CALLBACK (page_data_cache_size_changed),
+			  ev_window);
 
         return priv->settings;
 }
@@ -1595,6 +1623,29 @@ ev_window_clear_load_job (EvWindow *ev_window)
 	}
 }
 
+static void
+ev_window_clear_load_stream_job (EvWindow *ev_window)
+{
+	if (ev_window->priv->load_stream_job != NULL) {
+		if (!ev_job_is_finished (ev_window->priv->load_stream_job))
+			ev_job_cancel (ev_window->priv->load_stream_job);
+
+		g_signal_handlers_disconnect_by_func (ev_window->priv->load_stream_job, ev_window_load_stream_job_cb, ev_window);
+		g_object_unref (ev_window->priv->load_stream_job);
+		ev_window->priv->load_stream_job = NULL;
+	}
+}
+
+static void
+ev_window_cancel_range_fetch (EvWindow *ev_window)
+{
+	if (ev_window->priv->range_fetch_cancellable) {
+		g_cancellable_cancel (ev_window->priv->range_fetch_cancellable);
+		g_object_unref (ev_window->priv->range_fetch_cancellable);
+		ev_window->priv->range_fetch_cancellable = NULL;
+	}
+}
+
 static void
 ev_window_clear_reload_job (EvWindow *ev_window)
 {
@@ -1611,6 +1662,9 @@ ev_window_clear_reload_job (EvWindow *ev_window)
 static void
 ev_window_clear_local_uri (EvWindow *ev_window)
 {
+	ev_window_cancel_range_fetch (ev_window);
+	ev_window->priv->local_uri_partial = FALSE;
+
 	if (ev_window->priv->local_uri) {
 		ev_tmp_uri_unlink (ev_window->priv->local_uri);
 		g_free (ev_window->priv->local_uri);
@@ -1634,6 +1688,57 @@ ev_window_handle_link (EvWindow *ev_window,
 	}
 }
 
+static void
+ev_window_document_loaded (EvWindow    *ev_window,
+			   EvDocument  *document,
+			   const gchar *password)
+{
+	ev_document_model_set_document (ev_window->priv->model, document);
+
+#ifdef ENABLE_DBUS
+	ev_window_emit_doc_loaded (ev_window);
+#endif
+	setup_chrome_from_metadata (ev_window);
+	setup_document_from_metadata (ev_window);
+	setup_view_from_metadata (ev_window);
+
+	ev_window_add_recent (ev_window, ev_window->priv->uri);
+
+	ev_window_title_set_type (ev_window->priv->title,
+				  EV_WINDOW_TITLE_DOCUMENT);
+	if (password) {
+		GPasswordSave flags;
+
+		flags = ev_password_view_get_password_save_flags (
+			EV_PASSWORD_VIEW (ev_window->priv->password_view));
+		ev_keyring_save_password (ev_window->priv->uri,
+					  password,
+					  flags);
+	}
+
+	ev_window_handle_link (ev_window, ev_window->priv->dest);
+	g_clear_object (&ev_window->priv->dest);
+
+	switch (ev_window->priv->window_mode) {
+	        case EV_WINDOW_MODE_FULLSCREEN:
+			ev_window_run_fullscreen (ev_window);
+			break;
+	        case EV_WINDOW_MODE_PRESENTATION:
+			ev_window_run_presentation (ev_window);
+			break;
+	        default:
+			break;
+	}
+
+	/* Create a monitor for the document */
+	ev_window->priv->monitor = ev_file_monitor_new (ev_window->priv->uri);
+	g_signal_connect_swapped (ev_window->priv->monitor, "changed",
+				  G_CALLBACK (ev_window_file_changed),
+				  ev_window);
+	
+	ev_window_clear_load_job (ev_window);
+}
+
 /* This callback will executed when load job will be finished.
  *
  * Since the flow of the error dialog is very confusing, we assume that both
@@ -1658,50 +1763,7 @@ ev_window_load_job_cb (EvJob *job,
 
 	/* Success! */
 	if (!ev_job_is_failed (job)) {
-		ev_document_model_set_document (ev_window->priv->model, document);
-
-#ifdef ENABLE_DBUS
-		ev_window_emit_doc_loaded (ev_window);
-#endif
-		setup_chrome_from_metadata (ev_window);
-		setup_document_from_metadata (ev_window);
-		setup_view_from_metadata (ev_window);
-
-		ev_window_add_recent (ev_window, ev_window->priv->uri);
-
-		ev_window_title_set_type (ev_window->priv->title,
-					  EV_WINDOW_TITLE_DOCUMENT);
-		if (job_load->password) {
-			GPasswordSave flags;
-
-			flags = ev_password_view_get_password_save_flags (
-				EV_PASSWORD_VIEW (ev_window->priv->password_view));
-			ev_keyring_save_password (ev_window->priv->uri,
-						  job_load->password,
-						  flags);
-		}
-
-		ev_window_handle_link (ev_window, ev_window->priv->dest);
-		g_clear_object (&ev_window->priv->dest);
-
-		switch (ev_window->priv->window_mode) {
-		        case EV_WINDOW_MODE_FULLSCREEN:
-				ev_window_run_fullscreen (ev_window);
-				break;
-		        case EV_WINDOW_MODE_PRESENTATION:
-				ev_window_run_presentation (ev_window);
-				break;
-		        default:
-				break;
-		}
-
-		/* Create a monitor for the document */
-		ev_window->priv->monitor = ev_file_monitor_new (ev_window->priv->uri);
-		g_signal_connect_swapped (ev_window->priv->monitor, "changed",
-					  G_CALLBACK (ev_window_file_changed),
-					  ev_window);
-		
-		ev_window_clear_load_job (ev_window);
+		ev_window_document_loaded (ev_window, document, job_load->password);
 		return;
 	}
 
@@ -1921,6 +1983,17 @@ ev_window_load_remote_failed (EvWindow *ev_window,
 	ev_window->priv->uri_mtime = 0;
 }
 
+static void
+ev_window_load_remote_cancelled (EvWindow *ev_window)
+{
+	ev_window_clear_load_job (ev_window);
+	ev_window_clear_local_uri (ev_window);
+	g_free (ev_window->priv->uri);
+	ev_window->priv->uri = NULL;
+
+	ev_window_hide_loading_message (ev_window);
+}
+
 static void
 set_uri_mtime (GFile        *source,
 	       GAsyncResult *async_result,
@@ -1998,13 +2071,8 @@ window_open_file_copy_ready_cb (GFile        *source,
 					       ev_window);
 		g_object_unref (operation);
 	} else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
-		ev_window_clear_load_job (ev_window);
-		ev_window_clear_local_uri (ev_window);
-		g_free (ev_window->priv->uri);
-		ev_window->priv->uri = NULL;
+		ev_window_load_remote_cancelled (ev_window);
 		g_object_unref (source);
-
-		ev_window_hide_loading_message (ev_window);
 	} else {
 		ev_window_load_remote_failed (ev_window, error);
 		g_object_unref (source);
@@ -2039,12 +2107,238 @@ window_open_file_copy_progress_cb (goffset   n_bytes,
 	g_free (status);
 }
 
+typedef struct {
+	EvWindow         *ev_window;
+	GFileInputStream *stream;
+} RemoteStreamData;
+
+static void
+range_fetch_ready_cb (EvRangeInputStream *stream,
+		      GAsyncResult       *async_result,
+		      EvWindow           *ev_window)
+{
+	GError *error = NULL;
+	gchar  *cache_key;
+
+	if (g_task_get_cancellable (G_TASK (async_result)) != ev_window->priv->range_fetch_cancellable) {
+		/* Cancelled, a new fetch or a full download replaced it */
+		g_object_unref (ev_window);
+		return;
+	}
+
+	g_clear_object (&ev_window->priv->range_fetch_cancellable);
+
+	cache_key = g_task_propagate_pointer (G_TASK (async_result), &error);
+	if (!error && ev_window->priv->uri) {
+		/* The local copy is complete now, it can be sent and the
+		 * document can use the caches keyed by its file
+		 */
+		ev_window->priv->local_uri_partial = FALSE;
+		ev_window_setup_action_sensitivity (ev_window);
+		if (ev_window->priv->document) {
+			ev_document_set_uri (ev_window->priv->document,
+					     ev_window->priv->local_uri);
+			ev_document_set_cache_key (ev_window->priv->document,
+						   cache_key);
+		}
+
+		g_file_query_info_async (g_file_new_for_uri (ev_window->priv->uri),
+					 G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					 0, G_PRIORITY_DEFAULT,
+					 NULL,
+					 (GAsyncReadyCallback)set_uri_mtime,
+					 ev_window);
+	} else {
+		g_clear_error (&error);
+	}
+	g_free (cache_key);
+
+	g_object_unref (ev_window);
+}
+
+static void
+range_fetch_thread (GTask              *task,
+		    EvRangeInputStream *stream,
+		    const gchar        *local_uri,
+		    GCancellable       *cancellable)
+{
+	GError *error = NULL;
+
+	if (!ev_range_input_stream_fetch_all (stream, cancellable, &error)) {
+		g_task_return_error (task, error);
+		return;
+	}
+
+	/* The copy is what the document was loaded from, as long as the
+	 * remote file didn't change in the meantime
+	 */
+	g_task_return_pointer (task, ev_file_get_cache_key (local_uri, NULL), g_free);
+}
+
+static void
+ev_window_start_range_fetch (EvWindow           *ev_window,
+			     EvRangeInputStream *stream)
+{
+	GTask *task;
+
+	ev_window_cancel_range_fetch (ev_window);
+	ev_window->priv->range_fetch_cancellable = g_cancellable_new ();
+
+	/* Keep the window alive until the thread finishes, the fetch is
+	 * cancelled when the window is disposed
+	 */
+	task = g_task_new (stream, ev_window->priv->range_fetch_cancellable,
+			   (GAsyncReadyCallback)range_fetch_ready_cb,
+			   g_object_ref (ev_window));
+	g_task_set_task_data (task, g_strdup (ev_window->priv->local_uri), g_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc)range_fetch_thread);
+	g_object_unref (task);
+
+	/* Until then the local copy is a sparse file */
+	ev_window->priv->local_uri_partial = TRUE;
+	ev_window_setup_action_sensitivity (ev_window);
+}
+
+static void
+ev_window_load_stream_job_cb (EvJob    *job,
+			      EvWindow *ev_window)
+{
+	EvJobLoadStream *job_stream = EV_JOB_LOAD_STREAM (job);
+
+	if (ev_job_is_failed (job)) {
+		/* The backend can't load from a stream, or the document
+		 * needs a password: download the file and load it as usual
+		 */
+		ev_window_clear_load_stream_job (ev_window);
+		ev_window_copy_file_remote (ev_window,
+					    g_file_new_for_uri (ev_window->priv->uri));
+		return;
+	}
+
+	ev_window_hide_loading_message (ev_window);
+	ev_window_document_loaded (ev_window, job->document, NULL);
+
+	/* Fetch the rest of the document in the background so that the
+	 * local copy is available to reload, save or send the document
+	 */
+	ev_window_start_range_fetch (ev_window,
+				     EV_RANGE_INPUT_STREAM (job_stream->stream));
+	ev_window_clear_load_stream_job (ev_window);
+}
+
+static void
+window_open_file_info_ready_cb (GFile            *source,
+				GAsyncResult     *async_result,
+				RemoteStreamData *data)
+{
+	EvWindow     *ev_window = data->ev_window;
+	GFileInfo    *info;
+	GInputStream *range_stream = NULL;
+	GError       *error = NULL;
+
+	info = g_file_query_info_finish (source, async_result, &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		ev_window_load_remote_cancelled (ev_window);
+		g_object_unref (source);
+		g_object_unref (data->stream);
+		g_slice_free (RemoteStreamData, data);
+		g_error_free (error);
+
+		return;
+	}
+
+	if (info && g_file_info_get_size (info) > 0) {
+		const gchar *content_type;
+		gchar       *guessed_type = NULL;
+
+		content_type = g_file_info_get_content_type (info);
+		if (!content_type) {
+			gchar *basename = g_file_get_basename (source);
+
+			content_type = guessed_type = g_content_type_guess (basename, NULL, 0, NULL);
+			g_free (basename);
+		}
+
+		range_stream = ev_range_input_stream_new (data->stream,
+							  g_file_info_get_size (info),
+							  content_type,
+							  ev_window->priv->local_uri,
+							  NULL);
+		g_free (guessed_type);
+	}
+
+	if (info)
+		g_object_unref (info);
+	g_clear_error (&error);
+	g_object_unref (data->stream);
+	g_slice_free (RemoteStreamData, data);
+
+	if (!range_stream) {
+		ev_window_copy_file_remote (ev_window, source);
+		return;
+	}
+
+	g_object_unref (source);
+
+	ev_window_clear_progress_idle (ev_window);
+	ev_window_set_message_area (ev_window, NULL);
+	ev_window_show_loading_message (ev_window);
+
+	ev_window->priv->load_stream_job = ev_job_load_stream_new (range_stream,
+								   EV_DOCUMENT_LOAD_FLAG_NONE);
+	g_signal_connect (ev_window->priv->load_stream_job, "finished",
+			  G_CALLBACK (ev_window_load_stream_job_cb),
+			  ev_window);
+	ev_job_scheduler_push_job (ev_window->priv->load_stream_job, EV_JOB_PRIORITY_NONE);
+	g_object_unref (range_stream);
+}
+
+static void
+window_open_file_read_ready_cb (GFile        *source,
+				GAsyncResult *async_result,
+				EvWindow     *ev_window)
+{
+	GFileInputStream *stream;
+	RemoteStreamData *data;
+	GError           *error = NULL;
+
+	stream = g_file_read_finish (source, async_result, &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		ev_window_load_remote_cancelled (ev_window);
+		g_object_unref (source);
+		g_error_free (error);
+
+		return;
+	}
+	g_clear_error (&error);
+
+	if (!stream || !g_seekable_can_seek (G_SEEKABLE (stream))) {
+		/* The copy takes care of mounting the enclosing
+		 * volume and reporting errors
+		 */
+		if (stream)
+			g_object_unref (stream);
+		ev_window_copy_file_remote (ev_window, source);
+		return;
+	}
+
+	data = g_slice_new (RemoteStreamData);
+	data->ev_window = ev_window;
+	data->stream = stream;
+
+	g_file_query_info_async (source,
+				 G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
+				 G_FILE_ATTRIBUTE_STANDARD_SIZE,
+				 0, G_PRIORITY_DEFAULT,
+				 ev_window->priv->progress_cancellable,
+				 (GAsyncReadyCallback)window_open_file_info_ready_cb,
+				 data);
+}
+
 static void
 ev_window_load_file_remote (EvWindow *ev_window,
 			    GFile    *source_file)
 {
-	GFile *target_file;
-	
 	if (!ev_window->priv->local_uri) {
 		char *base_name, *template;
                 GFile *tmp_file;
@@ -2073,6 +2367,26 @@ ev_window_load_file_remote (EvWindow *ev_window,
 				     ev_window->priv->local_uri);
 	}
 
+	/* Try to read the document on demand first, it falls back
+	 * to downloading the whole file when that's not possible
+	 */
+	ev_window_reset_progress_cancellable (ev_window);
+	g_file_read_async (source_file,
+			   G_PRIORITY_DEFAULT,
+			   ev_window->priv->progress_cancellable,
+			   (GAsyncReadyCallback)window_open_file_read_ready_cb,
+			   ev_window);
+
+	ev_window_show_progress_message (ev_window, 1,
+					 (GSourceFunc)show_loading_progress);
+}
+
+static void
+ev_window_copy_file_remote (EvWindow *ev_window,
+			    GFile    *source_file)
+{
+	GFile *target_file;
+
 	ev_window_reset_progress_cancellable (ev_window);
 	
 	target_file = g_file_new_for_uri (ev_window->priv->local_uri);
@@ -2118,6 +2432,7 @@ ev_window_open_uri (EvWindow       *ev_window,
 	
 	ev_window_close_dialogs (ev_window);
 	ev_window_clear_load_job (ev_window);
+	ev_window_clear_load_stream_job (ev_window);
 	ev_window_clear_local_uri (ev_window);
 
 	ev_window->priv->window_mode = mode;
@@ -2185,6 +2500,7 @@ ev_window_open_document (EvWindow       *ev_window,
 
 	ev_window_close_dialogs (ev_window);
 	ev_window_clear_load_job (ev_window);
+	ev_window_clear_load_stream_job (ev_window);
 	ev_window_clear_local_uri (ev_window);
 
 	if (ev_window->priv->monitor) {
@@ -2297,6 +2613,7 @@ reload_remote_copy_ready_cb (GFile        *remote,
 						 "%s", _("Failed to reload document."));
 		g_error_free (error);
 	} else {
+		ev_window->priv->local_uri_partial = FALSE;
 		ev_window_reload_local (ev_window);
 	}
 		
@@ -2348,7 +2665,8 @@ query_remote_uri_mtime_cb (GFile        *remote,
 	}
 	
 	g_file_info_get_modification_time (info, &mtime);
-	if (ev_window->priv->uri_mtime != mtime.tv_sec) {
+	if (ev_window->priv->uri_mtime != mtime.tv_sec ||
+	    ev_window->priv->local_uri_partial) {
 		GFile *target_file;
 			
 		/* Remote file has changed */
@@ -2381,6 +2699,9 @@ ev_window_reload_remote (EvWindow *ev_window)
 {
 	GFile *remote;
 	
+	/* The reload downloads the file again */
+	ev_window_cancel_range_fetch (ev_window);
+
 	remote = g_file_new_for_uri (ev_window->priv->uri);
 	/* Reload the remote uri only if it has changed */
 	g_file_query_info_async (remote,
@@ -3549,7 +3870,10 @@ ev_window_print_range (EvWindow *ev_window,
 						    &range, 1);
 	}
 
+	/* Documents loaded from a stream don't have an URI */
 	document_uri = ev_document_get_uri (ev_window->priv->document);
+	if (!document_uri)
+		document_uri = ev_window->priv->uri;
 	output_basename = g_path_get_basename (document_uri);
 	dot = g_strrstr (output_basename, ".");
 	if (dot)
@@ -5473,12 +5797,15 @@ ev_window_search_start (EvWindow *ev_window)
 {
 	EggFindBar *find_bar = EGG_FIND_BAR (ev_window->priv->find_bar);
 	const char *search_string;
+	EvJob      *previous_job = NULL;
 
 	if (!ev_window->priv->document || !EV_IS_DOCUMENT_FIND (ev_window->priv->document))
 		return;
 
 	search_string = egg_find_bar_get_search_string (find_bar);
 
+	if (ev_window->priv->find_job)
+		previous_job = g_object_ref (ev_window->priv->find_job);
 	ev_window_clear_find_job (ev_window);
 	if (search_string && search_string[0]) {
 		EvFindOptions options = EV_FIND_DEFAULT;
@@ -5494,6 +5821,11 @@ ev_window_search_start (EvWindow *ev_window)
 		if (egg_find_bar_get_whole_words_only (find_bar))
 			options |= EV_FIND_WHOLE_WORDS_ONLY;
 		ev_job_find_set_options (EV_JOB_FIND (ev_window->priv->find_job), options);
+		/* Only search the pages matched by the previous search
+		 * when the search string has been extended */
+		if (previous_job)
+			ev_job_find_set_previous_job (EV_JOB_FIND (ev_window->priv->find_job),
+						      EV_JOB_FIND (previous_job));
 
 		ev_view_find_started (EV_VIEW (ev_window->priv->view), EV_JOB_FIND (ev_window->priv->find_job));
 		ev_find_sidebar_start (EV_FIND_SIDEBAR (ev_window->priv->find_sidebar),
@@ -5512,6 +5844,9 @@ ev_window_search_start (EvWindow *ev_window)
 		ev_find_sidebar_clear (EV_FIND_SIDEBAR (ev_window->priv->find_sidebar));
 		gtk_widget_queue_draw (GTK_WIDGET (ev_window->priv->view));
 	}
+
+	if (previous_job)
+		g_object_unref (previous_job);
 }
 
 static void
@@ -5877,6 +6212,10 @@ ev_window_dispose (GObject *object)
 		ev_window_clear_load_job (window);
 	}
 
+	if (priv->load_stream_job) {
+		ev_window_clear_load_stream_job (window);
+	}
+
 	if (priv->reload_job) {
 		ev_window_clear_reload_job (window);
 	}
@@ -5898,6 +6237,8 @@ ev_window_dispose (GObject *object)
 		priv->local_uri = NULL;
 	}
 
+	ev_window_cancel_range_fetch (window);
+
 	ev_window_clear_progress_idle (window);
 	if (priv->progress_cancellable) {
 		g_object_unref (priv->progress_cancellable);
@@ -7586,10 +7927,16 @@ ev_window_init (EvWindow *ev_window)
 	gtk_widget_show (ev_window->priv->view_box);
 
 	ev_window->priv->view = ev_view_new ();
+	ev_sidebar_thumbnails_set_view (EV_SIDEBAR_THUMBNAILS (ev_window->priv->sidebar_thumbs),
+					EV_VIEW (ev_window->priv->view));
 	page_cache_mb = g_settings_get_uint (ev_window_ensure_settings (ev_window),
 					     GS_PAGE_CACHE_SIZE);
 	ev_view_set_page_cache_size (EV_VIEW (ev_window->priv->view),
 				     page_cache_mb * 1024 * 1024);
+	page_cache_mb = g_settings_get_uint (ev_window_ensure_settings (ev_window),
+					     GS_PAGE_DATA_CACHE_SIZE);
+	ev_view_set_page_data_cache_size (EV_VIEW (ev_window->priv->view),
+					  page_cache_mb * 1024 * 1024);
 	ev_view_set_model (EV_VIEW (ev_window->priv->view), ev_window->priv->model);
 
 	ev_window->priv->password_view = ev_password_view_new (GTK_WINDOW (ev_window));
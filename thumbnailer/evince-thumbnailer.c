@@ -41,11 +41,15 @@ static gboolean finished = TRUE;
 
 static gint size = THUMBNAIL_SIZE;
 static gboolean time_limit = TRUE;
+static gboolean batch = FALSE;
+static gint n_jobs = 0;
 static const gchar **file_arguments;
 
 static const GOptionEntry goption_options[] = {
 	{ "size", 's', 0, G_OPTION_ARG_INT, &size, NULL, "SIZE" },
         { "no-limit", 'l', G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &time_limit, "Don't limit the thumbnailing time to 15 seconds", NULL },
+	{ "batch", 'b', 0, G_OPTION_ARG_NONE, &batch, "Read <input>\\t<output>[\\t<size>] requests from the standard input, one per line", NULL },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &n_jobs, "Number of requests processed in parallel in batch mode (1 by default). Documents are still loaded and rendered one at a time, only writing the PNG files runs in parallel", "N" },
 	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<input> <ouput>" },
 	{ NULL }
 };
@@ -57,6 +61,17 @@ struct AsyncData {
 	gboolean     success;
 };
 
+struct BatchRequest {
+	gchar  *input;
+	gchar  *output;
+	gint    size;
+	gint64  start_time;
+};
+
+/* Protects stdout and the requests not answered yet */
+static GMutex     output_mutex;
+static GPtrArray *pending_requests;
+
 /* Time monitor: copied from totem */
 G_GNUC_NORETURN static gpointer
 time_monitor (gpointer data)
@@ -111,6 +126,25 @@ evince_thumbnailer_get_document (GFile *file)
 	if (!g_file_is_native (file)) {
 		gchar *base_name, *template;
 
+		/* Backends able to load from a GFile read only what
+		 * they need from remote files instead of a full copy,
+		 * for the others the file is downloaded
+		 */
+		ev_document_doc_mutex_lock ();
+		document = ev_document_factory_get_document_for_gfile (file,
+								       EV_DOCUMENT_LOAD_FLAG_NO_CACHE,
+								       NULL, &error);
+		ev_document_doc_mutex_unlock ();
+		if (document)
+			return document;
+
+		if (g_error_matches (error, EV_DOCUMENT_ERROR, EV_DOCUMENT_ERROR_ENCRYPTED)) {
+			/* FIXME: Create a thumb for cryp docs */
+			g_error_free (error);
+			return NULL;
+		}
+		g_clear_error (&error);
+
 		base_name = g_file_get_basename (file);
 		template = g_strdup_printf ("document.XXXXXX-%s", base_name);
 		g_free (base_name);
@@ -138,7 +172,12 @@ evince_thumbnailer_get_document (GFile *file)
 		uri = g_file_get_uri (file);
 	}
 
-	document = ev_document_factory_get_document (uri, &error);
+	ev_document_doc_mutex_lock ();
+	/* Only the first page is needed */
+	document = ev_document_factory_get_document_full (uri,
+							  EV_DOCUMENT_LOAD_FLAG_NO_CACHE,
+							  &error);
+	ev_document_doc_mutex_unlock ();
 	if (tmp_file) {
 		if (document) {
 			g_object_weak_ref (G_OBJECT (document),
@@ -165,12 +204,12 @@ evince_thumbnailer_get_document (GFile *file)
 	return document;
 }
 
-static gboolean
-evince_thumbnail_pngenc_get (EvDocument *document, const char *thumbnail, int size)
+static cairo_surface_t *
+evince_thumbnail_get_surface (EvDocument *document, int size)
 {
 	EvRenderContext *rc;
 	double width, height;
-	GdkPixbuf *pixbuf;
+	cairo_surface_t *surface;
 	EvPage *page;
 
 	page = ev_document_get_page (document, 0);
@@ -178,20 +217,33 @@ evince_thumbnail_pngenc_get (EvDocument *document, const char *thumbnail, int si
 	ev_document_get_page_size (document, 0, &width, &height);
 
 	rc = ev_render_context_new (page, 0, size / width);
-	pixbuf = ev_document_get_thumbnail (document, rc);
+	surface = ev_document_get_thumbnail_surface (document, rc);
 	g_object_unref (rc);
 	g_object_unref (page);
-	
-	if (pixbuf != NULL) {
-		if (gdk_pixbuf_save (pixbuf, thumbnail, "png", NULL, NULL)) {
-			g_object_unref  (pixbuf);
-			return TRUE;
-		}
 
-		g_object_unref  (pixbuf);
-	}
-	
-	return FALSE;
+	return surface;
+}
+
+static gboolean
+evince_thumbnail_write_png (cairo_surface_t *surface, const char *filename)
+{
+	return cairo_surface_write_to_png (surface, filename) == CAIRO_STATUS_SUCCESS;
+}
+
+static gboolean
+evince_thumbnail_pngenc_get (EvDocument *document, const char *thumbnail, int size)
+{
+	cairo_surface_t *surface;
+	gboolean         retval;
+
+	surface = evince_thumbnail_get_surface (document, size);
+	if (!surface)
+		return FALSE;
+
+	retval = evince_thumbnail_write_png (surface, thumbnail);
+	cairo_surface_destroy (surface);
+
+	return retval;
 }
 
 static gpointer
@@ -208,6 +260,166 @@ evince_thumbnail_pngenc_get_async (struct AsyncData *data)
 	return NULL;
 }
 
+/* Batch mode: a long lived process thumbnailing a stream of files,
+ * so that the backends are only loaded once. Documents are loaded and
+ * rendered with the document mutex held, so with several jobs only the
+ * PNG encoding runs in parallel. Every request is answered with a line
+ * "ok\t<output>" or "error\t<output>"; they can be answered out of
+ * order.
+ *
+ * A hung backend can't be interrupted and keeps the document mutex, so
+ * like in single file mode the process exits when a request takes more
+ * than 15 seconds. Before that, every request read so far that was not
+ * answered, running or queued, is answered with an error, and clients
+ * have to send the failed requests other than the hung one again to a
+ * new process.
+ */
+static void
+batch_request_free (struct BatchRequest *request)
+{
+	g_free (request->input);
+	g_free (request->output);
+	g_slice_free (struct BatchRequest, request);
+}
+
+static void
+batch_process_request (struct BatchRequest *request,
+		       gpointer             user_data)
+{
+	EvDocument      *document;
+	cairo_surface_t *surface = NULL;
+	GFile           *file;
+	gboolean         success = FALSE;
+
+	g_mutex_lock (&output_mutex);
+	request->start_time = g_get_monotonic_time ();
+	g_mutex_unlock (&output_mutex);
+
+	file = g_file_new_for_commandline_arg (request->input);
+	document = evince_thumbnailer_get_document (file);
+	g_object_unref (file);
+
+	if (document) {
+		ev_document_doc_mutex_lock ();
+		surface = evince_thumbnail_get_surface (document, request->size);
+		g_object_unref (document);
+		ev_document_doc_mutex_unlock ();
+	}
+
+	if (surface) {
+		success = evince_thumbnail_write_png (surface, request->output);
+		cairo_surface_destroy (surface);
+	}
+
+	g_mutex_lock (&output_mutex);
+	g_ptr_array_remove (pending_requests, request);
+	g_print ("%s\t%s\n", success ? "ok" : "error", request->output);
+	fflush (stdout);
+	g_mutex_unlock (&output_mutex);
+
+	batch_request_free (request);
+}
+
+G_GNUC_NORETURN static gpointer
+batch_time_monitor (gpointer data)
+{
+	while (TRUE) {
+		gint64 now;
+		guint  i;
+
+		g_usleep (G_USEC_PER_SEC);
+
+		g_mutex_lock (&output_mutex);
+		now = g_get_monotonic_time ();
+		for (i = 0; i < pending_requests->len; i++) {
+			struct BatchRequest *request = g_ptr_array_index (pending_requests, i);
+
+			if (request->start_time == 0 ||
+			    now - request->start_time < DEFAULT_SLEEP_TIME)
+				continue;
+
+			g_printerr ("Couldn't process file: '%s'\n"
+				    "Reason: Took too much time to process.\n",
+				    request->input);
+			break;
+		}
+
+		if (i == pending_requests->len) {
+			g_mutex_unlock (&output_mutex);
+			continue;
+		}
+
+		/* Nothing is printed after this, the mutex is kept */
+		for (i = 0; i < pending_requests->len; i++) {
+			struct BatchRequest *request = g_ptr_array_index (pending_requests, i);
+
+			g_print ("error\t%s\n", request->output);
+		}
+		fflush (stdout);
+
+		exit (-2);
+	}
+}
+
+static int
+evince_thumbnailer_run_batch (void)
+{
+	GIOChannel  *channel;
+	GThreadPool *pool;
+	gchar       *line;
+	gsize        terminator_pos;
+
+	if (n_jobs < 1)
+		n_jobs = 1;
+
+	pending_requests = g_ptr_array_new ();
+	if (time_limit)
+		g_thread_new ("ThmbnlrBatchTimer", batch_time_monitor, NULL);
+
+	pool = g_thread_pool_new ((GFunc)batch_process_request, NULL,
+				  n_jobs, TRUE, NULL);
+
+#ifdef G_OS_WIN32
+	channel = g_io_channel_win32_new_fd (0);
+#else
+	channel = g_io_channel_unix_new (0);
+#endif
+	while (g_io_channel_read_line (channel, &line, NULL, &terminator_pos, NULL) == G_IO_STATUS_NORMAL) {
+		struct BatchRequest *request;
+		gchar              **fields;
+
+		line[terminator_pos] = '\0';
+		fields = g_strsplit (line, "\t", 3);
+		g_free (line);
+
+		if (!fields[0] || !fields[1]) {
+			g_printerr ("Invalid request, expected <input>\\t<output>[\\t<size>]\n");
+			g_strfreev (fields);
+			continue;
+		}
+
+		request = g_slice_new0 (struct BatchRequest);
+		request->input = g_strdup (fields[0]);
+		request->output = g_strdup (fields[1]);
+		request->size = fields[2] ? atoi (fields[2]) : size;
+		if (request->size < 1)
+			request->size = size;
+		g_strfreev (fields);
+
+		g_mutex_lock (&output_mutex);
+		g_ptr_array_add (pending_requests, request);
+		g_mutex_unlock (&output_mutex);
+
+		g_thread_pool_push (pool, request, NULL);
+	}
+	g_io_channel_unref (channel);
+
+	/* Wait for the pending requests */
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	return 0;
+}
+
 static void
 print_usage (GOptionContext *context)
 {
@@ -240,6 +452,25 @@ main (int argc, char *argv[])
 		return -1;
 	}
 
+	if (batch) {
+		gint retval;
+
+		g_option_context_free (context);
+
+		if (size < 1) {
+			g_printerr ("Size cannot be smaller than 1 pixel\n");
+			return -1;
+		}
+
+		if (!ev_init ())
+			return -1;
+
+		retval = evince_thumbnailer_run_batch ();
+		ev_shutdown ();
+
+		return retval;
+	}
+
 	input = file_arguments ? file_arguments[0] : NULL;
 	output = input ? file_arguments[1] : NULL;
 	if (!input || !output) {